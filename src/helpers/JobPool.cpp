@@ -0,0 +1,102 @@
+#include "JobPool.hpp"
+
+void JobPool::Token::cancel() {
+  cancelled = true;
+}
+
+bool JobPool::Token::isCancelled() {
+  return cancelled || (parent && parent->isCancelled());
+}
+
+void JobPool::Token::cancelAndWait() {
+  cancel();
+  while (running > 0) {
+    std::this_thread::yield();
+  }
+}
+
+// Never destroyed, as its threads may be stuck in a slow request when Rack exits, and joining them
+// would hold up the exit
+JobPool& JobPool::get() {
+  static JobPool* pool = new JobPool();
+  return *pool;
+}
+
+std::shared_ptr<JobPool::Token> JobPool::createToken(std::shared_ptr<Token> parent) {
+  std::shared_ptr<Token> token = std::make_shared<Token>();
+  token->parent = parent;
+  return token;
+}
+
+JobPool::JobPool() {
+  for (int i = 0; i < NUM_THREADS; i++) {
+    std::thread([this] { run(); }).detach();
+  }
+}
+
+bool JobPool::submit(std::shared_ptr<Token> token, Work work) {
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    if (queue.size() >= MAX_QUEUED_JOBS) {
+      return false;
+    }
+    queue.push_back(Job{token, work});
+  }
+  queueCondition.notify_one();
+  return true;
+}
+
+void JobPool::runCompletions() {
+  Done* stack = done.exchange(nullptr);
+
+  // The stack is newest first, so reverse it to run completions in the order jobs finished
+  Done* ordered = nullptr;
+  while (stack) {
+    Done* next = stack->next;
+    stack->next = ordered;
+    ordered = stack;
+    stack = next;
+  }
+
+  while (ordered) {
+    Done* next = ordered->next;
+    if (!ordered->token->isCancelled()) {
+      ordered->completion();
+    }
+    delete ordered;
+    ordered = next;
+  }
+}
+
+void JobPool::run() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(queueMutex);
+      queueCondition.wait(lock, [this] { return !queue.empty(); });
+      job = std::move(queue.front());
+      queue.pop_front();
+    }
+
+    // Counted before checking, so cancelAndWait either stops the job here or waits for it
+    job.token->running++;
+
+    Completion completion;
+    if (!job.token->isCancelled()) {
+      try {
+        completion = job.work();
+      } catch (...) {
+      }
+    }
+
+    job.token->running--;
+
+    if (!completion) {
+      continue;
+    }
+
+    Done* node = new Done{job.token, completion, done.load()};
+    while (!done.compare_exchange_weak(node->next, node)) {
+    }
+  }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// A few threads shared by the whole plugin for background work, like network requests and
+// regenerating values
+// Work runs on one of the threads and returns a completion, which runs on the UI thread the next
+// time runCompletions is called, unless the job has been cancelled by then
+struct JobPool {
+  // Cancels the jobs submitted with it, and with any token created from it
+  struct Token {
+    void cancel();
+    bool isCancelled();
+    // Cancels, then waits for jobs submitted with this token that already started - for owners of
+    // state the work itself uses. Jobs of tokens created from it are cancelled but not waited for,
+    // as they may be stuck in a slow request
+    void cancelAndWait();
+
+  private:
+    friend struct JobPool;
+
+    std::shared_ptr<Token> parent;
+    std::atomic<bool> cancelled{false};
+    // Jobs running that were submitted with this token
+    std::atomic<int> running{0};
+  };
+
+  using Completion = std::function<void()>;
+  using Work = std::function<Completion()>;
+
+  static JobPool& get();
+  static std::shared_ptr<Token> createToken(std::shared_ptr<Token> parent = nullptr);
+
+  // Returns false without queueing if too many jobs are already waiting
+  bool submit(std::shared_ptr<Token> token, Work work);
+  // Call regularly from the UI thread
+  void runCompletions();
+
+private:
+  static constexpr int NUM_THREADS = 2;
+  static constexpr size_t MAX_QUEUED_JOBS = 64;
+
+  JobPool();
+  void run();
+
+  struct Job {
+    std::shared_ptr<Token> token;
+    Work work;
+  };
+  std::deque<Job> queue;
+  std::mutex queueMutex;
+  std::condition_variable queueCondition;
+
+  // Completions waiting for the UI thread, pushed by workers onto a lock-free stack
+  struct Done {
+    std::shared_ptr<Token> token;
+    Completion completion;
+    Done* next;
+  };
+  std::atomic<Done*> done{nullptr};
+};
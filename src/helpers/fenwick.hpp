@@ -0,0 +1,29 @@
+# pragma once
+
+// Fenwick (binary indexed) trees over n counts, stored in tree[0..n), for O(log n) updates and
+// prefix sums
+
+// Turns counts in tree into a Fenwick tree, in O(n)
+inline void fenwickBuild(int* tree, int n) {
+  for (int i = 1; i <= n; i++) {
+    int parent = i + (i & -i);
+    if (parent <= n) {
+      tree[parent - 1] += tree[i - 1];
+    }
+  }
+}
+
+inline void fenwickAdd(int* tree, int n, int index, int delta) {
+  for (int i = index + 1; i <= n; i += i & -i) {
+    tree[i - 1] += delta;
+  }
+}
+
+// Sum of the counts at [0, end)
+inline int fenwickSum(const int* tree, int end) {
+  int sum = 0;
+  for (int i = end; i > 0; i -= i & -i) {
+    sum += tree[i - 1];
+  }
+  return sum;
+}
@@ -0,0 +1,19 @@
+# pragma once
+
+#include <cstdint>
+
+// Counter-based random values - any index of any seed can be computed on its own, with the same
+// results on every compiler and platform
+// This is the SplitMix64 finalizer applied to the seed and index together, so distinct pairs
+// never collide
+inline uint64_t hash(uint32_t seed, uint32_t index) {
+  uint64_t z = (((uint64_t)seed << 32) | index) + 0x9e3779b97f4a7c15ull;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1), using the top 24 bits so every value is exactly representable
+inline float hash01(uint32_t seed, uint32_t index) {
+  return (float)(hash(seed, index) >> 40) * (1.f / 16777216.f);
+}
@@ -4,14 +4,70 @@
 #include "ScaleParamQuantity.hpp"
 #include "StartParamQuantity.hpp"
 #include "../../helpers/clamp.hpp"
+#include "../../helpers/fenwick.hpp"
+#include "../../helpers/hash.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <random>
 #include <string>
 
 using namespace rack;
 
-EntropyBase::EntropyBase(int totalLength)
-  : totalLength(totalLength)
+namespace {
+  // Values are saved as base64 of their little-endian float32 bytes, which is a fraction of the
+  // size of a JSON number per value, and much faster to parse
+  const std::string VALUES_ENCODING = "base64-f32le";
+
+  std::string encodeValues(const float* values, int length) {
+    std::vector<uint8_t> bytes(length * 4);
+    for (int i = 0; i < length; i++) {
+      uint32_t bits;
+      std::memcpy(&bits, &values[i], sizeof(bits));
+      for (int b = 0; b < 4; b++) {
+        bytes[i * 4 + b] = (uint8_t)(bits >> (8 * b));
+      }
+    }
+    return string::toBase64(bytes);
+  }
+
+  std::vector<float> decodeValues(const std::string& encoded) {
+    std::vector<uint8_t> bytes = string::fromBase64(encoded);
+    std::vector<float> values(bytes.size() / 4);
+    for (size_t i = 0; i < values.size(); i++) {
+      uint32_t bits = 0;
+      for (int b = 0; b < 4; b++) {
+        bits |= (uint32_t)bytes[i * 4 + b] << (8 * b);
+      }
+      std::memcpy(&values[i], &bits, sizeof(bits));
+    }
+    return values;
+  }
+
+  bool isSameBits(float a, float b) {
+    return std::memcmp(&a, &b, sizeof(a)) == 0;
+  }
+
+  // Overrides are JSON numbers, which can't be NaN or infinite, and lose denormals wherever
+  // they're flushed to zero, so only pools without any are saved as overrides
+  bool isSavedExactly(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t exponent = bits & 0x7f800000u;
+    return exponent != 0x7f800000u && (exponent != 0 || (bits & 0x007fffffu) == 0);
+  }
+}
+
+const std::vector<int> EntropyBase::CONTROL_RATES = {1, 16, 32, 64};
+
+EntropyBase::EntropyBase(int totalLength, float* valueStorage, float* endlessStorage, int* indexStorage)
+  : totalLength(totalLength),
+    values(totalLength, valueStorage),
+    endlessValues(endlessStorage),
+    nextPassing(indexStorage),
+    previousPassing(indexStorage + MAX_CHANNELS * totalLength),
+    activeCounts(indexStorage + 2 * MAX_CHANNELS * totalLength),
+    sortedIndices(indexStorage + 3 * MAX_CHANNELS * totalLength)
 {
   config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
 
@@ -54,6 +110,7 @@ EntropyBase::EntropyBase(int totalLength)
   configOutput(TRIGGER_OUTPUT, "Trigger");
   configOutput(GATE_OUTPUT, "Gate");
   configOutput(CV_OUTPUT, "CV");
+  configOutput(DENSITY_OUTPUT, "Active step density");
 
   configParam<ScaleParamQuantity>(SCALE_PARAM, -1.f, 1.f, .1f, "Scale");
   getParamQuantity(SCALE_PARAM)->randomizeEnabled = false;
@@ -62,7 +119,30 @@ EntropyBase::EntropyBase(int totalLength)
   ((LengthParamQuantity*)getParamQuantity(LENGTH_PARAM))->totalLength = totalLength;
   ((StartParamQuantity*)getParamQuantity(START_PARAM))->totalLength = totalLength;
 
-  randomizeValues();
+  // Tables are built on first use, and until then skip and count nothing
+  std::fill(nextPassing, nextPassing + 2 * MAX_CHANNELS * totalLength, -1);
+  std::fill(activeCounts, activeCounts + MAX_CHANNELS * totalLength, 0);
+  for (int i = 0; i < totalLength; i++) {
+    sortedIndices[i] = i;
+  }
+}
+
+EntropyBase::~EntropyBase() {
+  jobToken->cancelAndWait();
+
+  if (savedValuesJson) {
+    json_decref(savedValuesJson);
+  }
+}
+
+// Patches are loaded between construction and being added, so values are only generated here if
+// the patch didn't have any
+void EntropyBase::onAdd(const AddEvent& e) {
+  Module::onAdd(e);
+
+  if (!hasLoadedValues) {
+    randomizeValues();
+  }
 }
 
 void EntropyBase::onRandomize() {
@@ -72,73 +152,156 @@ void EntropyBase::onRandomize() {
 }
 
 void EntropyBase::onReset() {
-  seed = 42u;
-  index = 0;
+  seed = DEFAULT_SEED;
+  setIndex(0);
+  std::fill(std::begin(pages), std::end(pages), 0u);
   randomizeValues();
 }
 
 void EntropyBase::process(const ProcessArgs& args) {
-  updateFilter();
+  int channels = getChannels();
   bool isRunning = updateRun();
   updateValues(args);
+  // Read before the values, so a change in between is seen next time rather than missed
+  audioValuesVersion = values.getVersion();
+  audioValues = values.read(ValuePool::AUDIO_READER);
+
+  // Buttons apply to every channel
+  bool clockPressed = clockButtonTrigger.process(params[CLOCK_PARAM].getValue());
+  bool resetPressed = resetButtonTrigger.process(params[RESET_PARAM].getValue());
+
+  // Newly added channels need their range before they can step
+  bool isControlTick = controlDivider.process() || channels != lastChannels;
+  lastChannels = channels;
+  // Only the density output needs the counts, and skipping, whose tables are patched along with
+  // them - the filter's tooltip counts for itself
+  bool isCountingActiveSteps = outputs[DENSITY_OUTPUT].isConnected() || isSkipFiltered;
+
+  eosMask = 0;
+  triggerMask = 0;
+  gateMask = 0;
+  for (int c = 0; c < channels; c += 4) {
+    float_4 didStep, didReset;
+    updateTriggers(c, isRunning, clockPressed, resetPressed, didStep, didReset);
+
+    // Clocks and resets always see an up to date range, so timing stays sample accurate
+    if (isControlTick || simd::movemask(didStep | didReset)) {
+      updateFilter(c);
+      updateRange(c);
+      if (isCountingActiveSteps) {
+        updateActiveSteps(c, channels);
+      }
+      if (isSkipFiltered && !isEndless) {
+        updatePassingIndices(c);
+      }
+    }
 
-  bool isReversed = updateRange();
-  updateIndex(args, isRunning, isReversed);
+    updateIndex(args, c, didStep, didReset);
+  }
+
+  for (int outputId : {EOS_OUTPUT, TRIGGER_OUTPUT, GATE_OUTPUT, CV_OUTPUT, DENSITY_OUTPUT}) {
+    outputs[outputId].setChannels(channels);
+  }
+
+  lights[CLOCK_LIGHT].setSmoothBrightness(clockPulse.process(args.sampleTime), args.sampleTime);
+  lights[RESET_LIGHT].setSmoothBrightness(resetPulse.process(args.sampleTime), args.sampleTime);
+  lights[EOS_LIGHT].setSmoothBrightness(eosMask != 0, args.sampleTime);
+  lights[TRIGGER_LIGHT].setSmoothBrightness(triggerMask != 0, args.sampleTime);
+  lights[GATE_LIGHT].setSmoothBrightness(gateMask != 0, args.sampleTime);
+
+  updateDisplay();
 }
 
-void EntropyBase::updateFilter() {
-  float filter = clamp11(
-    params[FILTER_PARAM].getValue() +
-    inputs[FILTER_INPUT].getVoltage() / 10.f * params[FILTER_CV_PARAM].getValue()
-  );
+// Mirrors channel 0 for the UI, only writing and bumping versions when something changed
+void EntropyBase::updateDisplay() {
+  int index = (int)indices[0][0];
+  if (index != this->index) {
+    this->index = index;
+  }
 
-  if (filter == 0.f) {
-    minValue = 0.f;
-    maxValue = 1.f;
-  } else if (filter > 0.f) {
-    minValue = filter;
-    maxValue = 1.f;
-  } else {
-    minValue = 0.f;
-    maxValue = 1 + filter;
+  int minIndex = (int)minIndices[0][0];
+  int maxIndex = (int)maxIndices[0][0];
+  if (minIndex != this->minIndex || maxIndex != this->maxIndex) {
+    this->minIndex = minIndex;
+    this->maxIndex = maxIndex;
+    rangeVersion++;
+  }
+
+  float minValue = minValues[0][0];
+  float maxValue = maxValues[0][0];
+  if (minValue != this->minValue || maxValue != this->maxValue) {
+    this->minValue = minValue;
+    this->maxValue = maxValue;
+    filterVersion++;
+  }
+
+  if (pages[0] != page) {
+    page = pages[0];
+    endlessVersion++;
+  }
+}
+
+int EntropyBase::getChannels() {
+  int channels = 1;
+  for (int inputId : {CLOCK_INPUT, RESET_INPUT, START_INPUT, LENGTH_INPUT, FILTER_INPUT}) {
+    channels = std::max(channels, inputs[inputId].getChannels());
   }
+  return std::min(channels, MAX_CHANNELS);
 }
 
-bool EntropyBase::updateRange() {
-  float initialStartRatio = clamp01(params[START_PARAM].getValue());
-  int initialStartIndex = (int)(initialStartRatio * (float)(totalLength - 0.5f));
+void EntropyBase::updateTriggers(int c, bool isRunning, bool clockPressed, bool resetPressed, float_4& didStep, float_4& didReset) {
+  int g = c / 4;
 
-  float startRatio = clamp01(
-    initialStartRatio +
-    inputs[START_INPUT].getVoltage() / 10.f * params[START_CV_PARAM].getValue()
-  );
-  int startIndex = (int)(startRatio * (float)(totalLength - 0.5f));
+  didStep = clockTriggers[g].process(inputs[CLOCK_INPUT].getPolyVoltageSimd<float_4>(c));
+  if (clockPressed) {
+    didStep = float_4::mask();
+  }
+  if (!isRunning) {
+    didStep = 0.f;
+  }
+
+  didReset = resetTriggers[g].process(inputs[RESET_INPUT].getPolyVoltageSimd<float_4>(c));
+  if (resetPressed) {
+    didReset = float_4::mask();
+  }
+}
 
-  float initialLengthRatio = clamp11(params[LENGTH_PARAM].getValue());
-  int initialLength = (int)(initialLengthRatio * (float)(totalLength - 0.5f));
-  float lengthRatio = clamp11(
-    initialLengthRatio +
-    inputs[LENGTH_INPUT].getVoltage() / 10.f * params[LENGTH_CV_PARAM].getValue()
+void EntropyBase::updateFilter(int c) {
+  int g = c / 4;
+  float_4 filter = simd::clamp(
+    params[FILTER_PARAM].getValue() +
+    inputs[FILTER_INPUT].getPolyVoltageSimd<float_4>(c) / 10.f * params[FILTER_CV_PARAM].getValue(),
+    -1.f, 1.f
   );
-  int length = (int)(lengthRatio * (float)(totalLength - 0.5f));
 
-  bool isReversed = length < 0;
-  if (isReversed) {
-    minIndex = clampRangeIndex(startIndex + length);
-    maxIndex = clampRangeIndex(startIndex);
-    initialLength--;
-  } else {
-    minIndex = clampRangeIndex(startIndex);
-    maxIndex = clampRangeIndex(startIndex + length);
-    initialLength++;
-  }
+  minValues[g] = simd::ifelse(filter > 0.f, filter, 0.f);
+  maxValues[g] = simd::ifelse(filter < 0.f, 1.f + filter, 1.f);
+}
 
-  ((StartParamQuantity*)getParamQuantity(START_PARAM))->index = clampRangeIndex(initialStartIndex);
-  ((LengthParamQuantity*)getParamQuantity(LENGTH_PARAM))->length = initialLength;
+void EntropyBase::updateRange(int c) {
+  int g = c / 4;
+  float span = totalLength - 0.5f;
+
+  float_4 startRatio = simd::clamp(
+    clamp01(params[START_PARAM].getValue()) +
+    inputs[START_INPUT].getPolyVoltageSimd<float_4>(c) / 10.f * params[START_CV_PARAM].getValue(),
+    0.f, 1.f
+  );
+  // Converting through int32_4 truncates towards zero, like the int casts this replaced
+  float_4 startIndex = float_4(simd::int32_4(startRatio * span));
+
+  float_4 lengthRatio = simd::clamp(
+    clamp11(params[LENGTH_PARAM].getValue()) +
+    inputs[LENGTH_INPUT].getPolyVoltageSimd<float_4>(c) / 10.f * params[LENGTH_CV_PARAM].getValue(),
+    -1.f, 1.f
+  );
+  float_4 length = float_4(simd::int32_4(lengthRatio * span));
 
-  clampIndex(isReversed);
+  isReversed[g] = length < 0.f;
+  minIndices[g] = clampRangeIndex(startIndex + simd::ifelse(isReversed[g], length, 0.f));
+  maxIndices[g] = clampRangeIndex(startIndex + simd::ifelse(isReversed[g], 0.f, length));
 
-  return isReversed;
+  clampIndex(c);
 }
 
 bool EntropyBase::updateRun() {
@@ -157,99 +320,331 @@ void EntropyBase::updateValues(const ProcessArgs& args) {
     randomButtonTrigger.process(params[RANDOM_PARAM].getValue()) ||
     randomTrigger.process(inputs[RANDOM_INPUT].getVoltage())
   ) {
-    randomizeSeed();
-    randomizeValues();
+    uint32_t nextSeed;
+    if (values.swapNext(nextSeed)) {
+      seed = nextSeed;
+    } else {
+      isRandomizePending = true;
+    }
     randomPulse.trigger(1e-3f);
   }
 
   lights[RANDOM_LIGHT].setSmoothBrightness(randomPulse.process(args.sampleTime), args.sampleTime);
 }
 
-void EntropyBase::updateIndex(const ProcessArgs& args, bool isRunning, bool isReversed) {
-  bool didStep = false;
-  if (isRunning && (
-    clockButtonTrigger.process(params[CLOCK_PARAM].getValue()) ||
-    clockTrigger.process(inputs[CLOCK_INPUT].getVoltage())
-  )) {
-    index += isReversed ? -1 : 1;
-    didStep = true;
+void EntropyBase::updateIndex(const ProcessArgs& args, int c, float_4 didStep, float_4 didReset) {
+  int g = c / 4;
+
+  // Values are only looked up when some channel steps
+  float_4 value = 0.f;
+  if (simd::movemask(didStep)) {
+    // Ranges can wrap past either end of the pool, so the playhead has to as well
+    indices[g] = clampRangeIndex(indices[g] + simd::ifelse(didStep, simd::ifelse(isReversed[g], -1.f, 1.f), 0.f));
     clockPulse.trigger(1e-3f);
 
-    if (clampIndex(isReversed)) {
-      eosPulse.trigger(1e-3f);
+    float_4 didEnd = didStep & clampIndex(c);
+    if (isSkipFiltered && !isEndless) {
+      skipFilteredSteps(c, didStep, didEnd);
     }
+    eosPulses[g].trigger(simd::ifelse(didEnd, 1e-3f, 0.f));
 
-    if (getValue() > 0.f) {
-      triggerPulse.trigger(1e-3f);
+    if (isEndless) {
+      int endMask = simd::movemask(didEnd);
+      for (int i = 0; i < 4; i++) {
+        if (endMask & (1 << i)) {
+          pages[c + i]++;
+        }
+      }
     }
-  }
 
-  lights[CLOCK_LIGHT].setSmoothBrightness(clockPulse.process(args.sampleTime), args.sampleTime);
+    value = getValue(c);
+    triggerPulses[g].trigger(simd::ifelse(didStep & (value > 0.f), 1e-3f, 0.f));
+  }
 
-  if (
-    resetButtonTrigger.process(params[RESET_PARAM].getValue()) ||
-    resetTrigger.process(inputs[RESET_INPUT].getVoltage())
-  ) {
-    index = isReversed ? maxIndex : minIndex;
+  if (simd::movemask(didReset)) {
+    indices[g] = simd::ifelse(didReset, simd::ifelse(isReversed[g], maxIndices[g], minIndices[g]), indices[g]);
     resetPulse.trigger(1e-3f);
+
+    if (isSkipFiltered && !isEndless) {
+      float_4 didEnd = float_4::mask();
+      skipFilteredSteps(c, didReset & didStep, didEnd);
+    }
+
+    if (simd::movemask(didStep)) {
+      value = getValue(c);
+    }
   }
 
-  lights[RESET_LIGHT].setSmoothBrightness(resetPulse.process(args.sampleTime), args.sampleTime);
+  // Pulses come back as 1 or 0 per lane, so compare to get a mask
+  float_4 isEos = eosPulses[g].process(args.sampleTime) != 0.f;
+  eosMask |= simd::movemask(isEos);
+  outputs[EOS_OUTPUT].setVoltageSimd(simd::ifelse(isEos, 10.f, 0.f), c);
 
-  if (didStep) {
-    bool hitEos = eosPulse.process(args.sampleTime);
-    lights[EOS_LIGHT].setSmoothBrightness(hitEos, args.sampleTime);
-    outputs[EOS_OUTPUT].setVoltage(hitEos ? 10.f : 0.f);
+  float_4 isTrigger = triggerPulses[g].process(args.sampleTime) != 0.f;
+  triggerMask |= simd::movemask(isTrigger);
+  outputs[TRIGGER_OUTPUT].setVoltageSimd(simd::ifelse(isTrigger, 10.f, 0.f), c);
 
-    bool hitTrigger = triggerPulse.process(args.sampleTime);
-    lights[TRIGGER_LIGHT].setSmoothBrightness(hitTrigger, args.sampleTime);
-    outputs[TRIGGER_OUTPUT].setVoltage(hitTrigger ? 10.f : 0.f);
-    outputs[TRIGGER_OUTPUT].setVoltage(hitTrigger ? 10.f : 0.f);
+  cvs[g] = simd::ifelse(didStep, scaleValue(value), cvs[g]);
+  outputs[CV_OUTPUT].setVoltageSimd(cvs[g], c);
 
-    float value = getValue();
-    outputs[CV_OUTPUT].setVoltage(scaleValue(value));
-    updateGateOutput(args, value, didStep);
+  updateGateOutput(args, c, value, didStep);
+}
+
+void EntropyBase::updateGateOutput(const ProcessArgs& args, int c, float_4 value, float_4 didStep) {
+  int g = c / 4;
+
+  timeSinceLastClock[g] += args.sampleTime;
+  gateTime[g] += args.sampleTime;
+
+  if (simd::movemask(didStep)) {
+    // Can't output gates until we have at least one clock trigger for duration calculations
+    float_4 startsGate = didStep & hasStepped[g];
+    gateTime[g] = simd::ifelse(startsGate, 0.f, gateTime[g]);
+    maxGateTime[g] = simd::ifelse(startsGate, timeSinceLastClock[g] * value, maxGateTime[g]);
+
+    hasStepped[g] |= didStep;
+    timeSinceLastClock[g] = simd::ifelse(didStep, 0.f, timeSinceLastClock[g]);
   }
+
+  float_4 isGateActive = gateTime[g] < maxGateTime[g];
+  gateMask |= simd::movemask(isGateActive);
+  outputs[GATE_OUTPUT].setVoltageSimd(simd::ifelse(isGateActive, 10.f, 0.f), c);
 }
 
-void EntropyBase::updateGateOutput(const ProcessArgs& args, float value, bool didStep) {
-  timeSinceLastClock += args.sampleTime;
+// Counts active steps in the range of each of the group's channels, updating the channel's tree
+// from its last filter by visiting only the values between the old and new bounds
+void EntropyBase::updateActiveSteps(int c, int channels) {
+  int g = c / 4;
+  int n = totalLength;
+
+  // Endless values are uniform, so only the average is known
+  if (isEndless) {
+    densities[g] = maxValues[g] - minValues[g];
+    outputs[DENSITY_OUTPUT].setVoltageSimd(densities[g] * 10.f, c);
+    return;
+  }
+
+  if (sortedVersion != audioValuesVersion) {
+    sortValues();
+  }
+
+  // Trees of channels past the last are updated from wherever they were left once they're in use
+  for (int i = 0; i < 4 && c + i < channels; i++) {
+    int* counts = activeCounts + (c + i) * n;
+    // Skip tables that are up to date are patched along with the counts, rather than rebuilt
+    bool isPassingCurrent = isSkipFiltered && passingChanges[c + i] == passChanges[c + i];
+    float minValue = minValues[g][i];
+    float maxValue = maxValues[g][i];
+    float oldMinValue = activeMinValues[c + i];
+    float oldMaxValue = activeMaxValues[c + i];
 
-  if (isGateActive) {
-    gateTime += args.sampleTime;
-    if (gateTime >= maxGateTime) {
-      isGateActive = false;
+    if (activeVersions[c + i] != audioValuesVersion) {
+      for (int index = 0; index < n; index++) {
+        counts[index] = minValue <= audioValues[index] && audioValues[index] <= maxValue;
+      }
+      fenwickBuild(counts, n);
+      passChanges[c + i]++;
+    } else if (minValue != oldMinValue || maxValue != oldMaxValue) {
+      // Values between the old and new min, and between the old and new max, merged when they
+      // overlap so no index is toggled twice
+      float fromValues[2] = {std::min(oldMinValue, minValue), std::min(oldMaxValue, maxValue)};
+      float toValues[2] = {std::max(oldMinValue, minValue), std::max(oldMaxValue, maxValue)};
+      int spans = 2;
+      if (fromValues[1] <= toValues[0]) {
+        toValues[0] = std::max(toValues[0], toValues[1]);
+        spans = 1;
+      }
+
+      // Patching costs the distance between passing indices, which on sorted pools grows with every
+      // index toggled, so past about a pool's worth the tables are left for a full rebuild
+      int patchBudget = n;
+      bool didChange = false;
+      for (int span = 0; span < spans; span++) {
+        float fromValue = fromValues[span];
+        const int* it = std::lower_bound(sortedIndices, sortedIndices + n, fromValue, [&](int index, float value) {
+          return audioValues[index] < value;
+        });
+        for (; it != sortedIndices + n && audioValues[*it] <= toValues[span]; ++it) {
+          float value = audioValues[*it];
+          bool wasActive = oldMinValue <= value && value <= oldMaxValue;
+          bool isActive = minValue <= value && value <= maxValue;
+          if (wasActive != isActive) {
+            fenwickAdd(counts, n, *it, isActive ? 1 : -1);
+            if (isPassingCurrent) {
+              patchBudget -= updatePassingIndex(c + i, *it, isActive);
+              isPassingCurrent = patchBudget > 0;
+            }
+            didChange = true;
+          }
+        }
+      }
+      if (didChange) {
+        passChanges[c + i]++;
+        if (isPassingCurrent) {
+          passingChanges[c + i] = passChanges[c + i];
+        }
+      }
     }
+
+    activeVersions[c + i] = audioValuesVersion;
+    activeMinValues[c + i] = minValue;
+    activeMaxValues[c + i] = maxValue;
+
+    int minIndex = (int)minIndices[g][i];
+    int maxIndex = (int)maxIndices[g][i];
+    int count = minIndex <= maxIndex
+      ? fenwickSum(counts, maxIndex + 1) - fenwickSum(counts, minIndex)
+      : fenwickSum(counts, n) - fenwickSum(counts, minIndex) + fenwickSum(counts, maxIndex + 1);
+    densities[g][i] = (float)count / ((maxIndex - minIndex + n) % n + 1);
   }
 
-  if (didStep) {
-    // Can't output gates until we have at least one clock trigger for duration calculations
-    if (hasStepped) {
-      gateTime = 0.f;
-      maxGateTime = timeSinceLastClock * value;
-      isGateActive = maxGateTime > 0.f;
-    } else {
-      hasStepped = true;
+  outputs[DENSITY_OUTPUT].setVoltageSimd(densities[g] * 10.f, c);
+}
+
+void EntropyBase::sortValues() {
+  for (int i = 0; i < totalLength; i++) {
+    sortedIndices[i] = i;
+  }
+  std::sort(sortedIndices, sortedIndices + totalLength, [&](int a, int b) {
+    return audioValues[a] < audioValues[b];
+  });
+  sortedVersion = audioValuesVersion;
+}
+
+// Rebuilds the tables for channels whose active steps changed without them being patched, like
+// when the values change or skipping is turned on
+void EntropyBase::updatePassingIndices(int c) {
+  int g = c / 4;
+  int n = totalLength;
+
+  for (int i = 0; i < 4; i++) {
+    if (passingChanges[c + i] == passChanges[c + i]) {
+      continue;
+    }
+    passingChanges[c + i] = passChanges[c + i];
+    float minValue = minValues[g][i];
+    float maxValue = maxValues[g][i];
+
+    // Two laps, so the end of the pool can find passing indices at its start and vice versa
+    int* next = nextPassing + (c + i) * n;
+    int passing = -1;
+    for (int k = 2 * n - 1; k >= 0; k--) {
+      int index = k % n;
+      if (minValue <= audioValues[index] && audioValues[index] <= maxValue) {
+        passing = index;
+      }
+      next[index] = passing;
     }
 
-    timeSinceLastClock = 0.f;
+    int* previous = previousPassing + (c + i) * n;
+    passing = -1;
+    for (int k = 0; k < 2 * n; k++) {
+      int index = k % n;
+      if (minValue <= audioValues[index] && audioValues[index] <= maxValue) {
+        passing = index;
+      }
+      previous[index] = passing;
+    }
+  }
+}
+
+// Patches channel c's tables for one index starting or stopping passing, which only touches the
+// entries between it and the passing indices either side of it - returns how many it touched
+int EntropyBase::updatePassingIndex(int c, int index, bool isPassing) {
+  int n = totalLength;
+  int* next = nextPassing + c * n;
+  int* previous = previousPassing + c * n;
+
+  // The tables don't include the change yet, so these are the closest passing indices either side,
+  // or index itself if nothing else passes
+  int before = previous[(index + n - 1) % n];
+  int after = next[(index + 1) % n];
+
+  if (before < 0 || before == index) {
+    std::fill(next, next + n, isPassing ? index : -1);
+    std::fill(previous, previous + n, isPassing ? index : -1);
+    return 2 * n;
   }
 
-  lights[GATE_LIGHT].setSmoothBrightness(isGateActive, args.sampleTime);
-  outputs[GATE_OUTPUT].setVoltage(isGateActive ? 10.f : 0.f);
+  int touched = 0;
+  for (int k = index; k != before; k = (k + n - 1) % n, touched++) {
+    next[k] = isPassing ? index : after;
+  }
+  for (int k = index; k != after; k = (k + 1) % n, touched++) {
+    previous[k] = isPassing ? index : before;
+  }
+  return touched;
 }
 
-float EntropyBase::getValue() {
-  float value = values[index];
+// Moves the given lanes on to passing steps, wrapping back to the start of the range if there are
+// none before its end, which then counts as the end of the sequence
+void EntropyBase::skipFilteredSteps(int c, float_4 lanes, float_4& didEnd) {
+  int g = c / 4;
+  int laneMask = simd::movemask(lanes);
+  int endMask = simd::movemask(didEnd);
+  int reversedMask = simd::movemask(isReversed[g]);
+
+  for (int i = 0; i < 4; i++) {
+    if (!(laneMask & (1 << i))) {
+      continue;
+    }
+
+    int passing = findPassingIndex(c + i, (int)indices[g][i]);
+    if (passing < 0 && !(endMask & (1 << i))) {
+      int start = (int)((reversedMask & (1 << i)) ? maxIndices[g][i] : minIndices[g][i]);
+      passing = findPassingIndex(c + i, start);
+      if (passing >= 0) {
+        endMask |= 1 << i;
+      }
+    }
 
-  if (minValue <= value && value <= maxValue) {
-    return value;
+    // With nothing in range passing, playheads step as usual
+    if (passing >= 0) {
+      indices[g][i] = (float)passing;
+    }
+  }
+
+  didEnd = simd::movemaskInverse<float_4>(endMask);
+}
+
+// The first passing index from index on, in the direction channel c plays, if it comes before the
+// end of the range - otherwise -1
+int EntropyBase::findPassingIndex(int c, int index) {
+  int g = c / 4;
+  int i = c % 4;
+  int n = totalLength;
+
+  if (simd::movemask(isReversed[g]) & (1 << i)) {
+    int passing = previousPassing[c * n + index];
+    int end = (int)minIndices[g][i];
+    return passing >= 0 && (index - passing + n) % n <= (index - end + n) % n ? passing : -1;
   } else {
-    return 0.f;
+    int passing = nextPassing[c * n + index];
+    int end = (int)maxIndices[g][i];
+    return passing >= 0 && (passing - index + n) % n <= (end - index + n) % n ? passing : -1;
   }
 }
 
-float EntropyBase::scaleValue(float value) {
+EntropyBase::float_4 EntropyBase::getValue(int c) {
+  int g = c / 4;
+
+  float_4 value;
+  if (isEndless) {
+    uint32_t seed = this->seed;
+    for (int i = 0; i < 4; i++) {
+      uint32_t position = pages[c + i] * (uint32_t)totalLength + (uint32_t)indices[g][i];
+      value[i] = hash01(seed, position);
+    }
+  } else {
+    for (int i = 0; i < 4; i++) {
+      value[i] = audioValues[(int)indices[g][i]];
+    }
+  }
+
+  return simd::ifelse((minValues[g] <= value) & (value <= maxValues[g]), value, 0.f);
+}
+
+EntropyBase::float_4 EntropyBase::scaleValue(float_4 value) {
   float scale = params[SCALE_PARAM].getValue() * 10.f;
   if (scale >= 0) {
     return value * scale;
@@ -258,7 +653,30 @@ float EntropyBase::scaleValue(float value) {
   }
 }
 
+void EntropyBase::countActiveSteps(int& count, float& density) {
+  float minValue = this->minValue;
+  float maxValue = this->maxValue;
+  if (isEndless) {
+    count = -1;
+    density = maxValue - minValue;
+    return;
+  }
+
+  const float* values = getDisplayValues();
+  int minIndex = this->minIndex;
+  int maxIndex = this->maxIndex;
+  int length = (maxIndex - minIndex + totalLength) % totalLength + 1;
+  count = 0;
+  for (int k = 0; k < length; k++) {
+    float value = values[(minIndex + k) % totalLength];
+    count += minValue <= value && value <= maxValue;
+  }
+  density = (float)count / length;
+}
+
 bool EntropyBase::isInRange(int index) const {
+  int minIndex = this->minIndex;
+  int maxIndex = this->maxIndex;
   if (minIndex <= maxIndex) {
     return index >= minIndex && index <= maxIndex;
   } else {
@@ -266,78 +684,377 @@ bool EntropyBase::isInRange(int index) const {
   }
 }
 
-bool EntropyBase::clampIndex(bool isReversed) {
-  if (!isInRange(index)) {
-    index = isReversed ? maxIndex : minIndex;
-    return true;
-  } else {
-    return false;
-  }
+EntropyBase::float_4 EntropyBase::isInRange(float_4 index, float_4 minIndex, float_4 maxIndex) {
+  return simd::ifelse(
+    minIndex <= maxIndex,
+    (index >= minIndex) & (index <= maxIndex),
+    (index >= minIndex) | (index <= maxIndex)
+  );
 }
 
-int EntropyBase::clampRangeIndex(int index) {
-  if (index < 0) {
-    return index + totalLength;
-  } else if (index >= totalLength) {
-    return index - totalLength;
-  } else {
-    return index;
+EntropyBase::float_4 EntropyBase::clampIndex(int c) {
+  int g = c / 4;
+
+  float_4 isOutOfRange = ~isInRange(indices[g], minIndices[g], maxIndices[g]);
+  indices[g] = simd::ifelse(isOutOfRange, simd::ifelse(isReversed[g], maxIndices[g], minIndices[g]), indices[g]);
+
+  return isOutOfRange;
+}
+
+EntropyBase::float_4 EntropyBase::clampRangeIndex(float_4 index) {
+  float length = (float)totalLength;
+  return simd::ifelse(index < 0.f, index + length, simd::ifelse(index >= length, index - length, index));
+}
+
+int EntropyBase::getControlRate() {
+  return (int)controlDivider.getDivision();
+}
+
+void EntropyBase::setControlRate(int controlRate) {
+  controlDivider.setDivision(std::max(controlRate, 1));
+}
+
+void EntropyBase::setIndex(int index) {
+  this->index = index;
+  for (int g = 0; g < MAX_GROUPS; g++) {
+    indices[g] = (float)index;
   }
 }
 
 void EntropyBase::randomizeSeed() {
-  std::random_device rd;
-  seed = (uint32_t(rd()) << 16) ^ uint32_t(rd());
+  seed = generateSeed();
 }
 
 void EntropyBase::randomizeValues() {
+  Engine engine = getEngine();
+  uint32_t seed = this->seed;
+  values.write([&](float* values) {
+    generateValues(engine, seed, values, 0, totalLength);
+  });
+}
+
+void EntropyBase::restoreRange() {
+  Engine engine = getEngine();
+  uint32_t seed = this->seed;
+  int minIndex = this->minIndex;
+  int maxIndex = this->maxIndex;
+
+  values.write([&](float* values) {
+    if (minIndex <= maxIndex) {
+      generateValues(engine, seed, values, minIndex, maxIndex + 1);
+    } else {
+      generateValues(engine, seed, values, minIndex, totalLength);
+      generateValues(engine, seed, values, 0, maxIndex + 1);
+    }
+  });
+}
+
+EntropyBase::Engine EntropyBase::getEngine() {
+  return (Engine)engine.load();
+}
+
+bool EntropyBase::getEndless() {
+  return isEndless;
+}
+
+void EntropyBase::setEndless(bool isEndless) {
+  this->isEndless = isEndless;
+  endlessVersion++;
+}
+
+bool EntropyBase::getSkipFiltered() {
+  return isSkipFiltered;
+}
+
+void EntropyBase::setSkipFiltered(bool isSkipFiltered) {
+  this->isSkipFiltered = isSkipFiltered;
+}
+
+uint32_t EntropyBase::getValuesVersion() {
+  // Both only ever increase, so neither can undo a change to the other
+  return values.getVersion() + endlessVersion;
+}
+
+const float* EntropyBase::getDisplayValues() {
+  if (!isEndless) {
+    return values.read(ValuePool::UI_READER);
+  }
+
+  uint32_t version = getValuesVersion();
+  if (hasEndlessValues && version == endlessValuesVersion) {
+    return endlessValues;
+  }
+
+  uint32_t seed = this->seed;
+  uint32_t page = this->page;
+  for (int i = 0; i < totalLength; i++) {
+    endlessValues[i] = hash01(seed, page * (uint32_t)totalLength + (uint32_t)i);
+  }
+  hasEndlessValues = true;
+  endlessValuesVersion = version;
+  return endlessValues;
+}
+
+void EntropyBase::setEngine(Engine engine) {
+  this->engine = engine;
+
+  // Values waiting for the RANDOM trigger came from the old engine
+  values.discardNext();
+  randomizeValues();
+}
+
+void EntropyBase::prepareRandomValues() {
+  if (isRandomizePending.exchange(false)) {
+    randomizeSeed();
+    randomizeValues();
+  }
+
+  if (!values.hasNext() && !isPreparingNext.exchange(true)) {
+    bool isSubmitted = JobPool::get().submit(jobToken, [this]() {
+      // The engine is read under prepareNext's lock, so a setEngine racing with this discards
+      // whatever it prepares
+      uint32_t nextSeed = generateSeed();
+      values.prepareNext(nextSeed, [&](float* values) {
+        generateValues(getEngine(), nextSeed, values, 0, totalLength);
+      });
+      isPreparingNext = false;
+      return JobPool::Completion();
+    });
+
+    if (!isSubmitted) {
+      isPreparingNext = false;
+    }
+  }
+}
+
+uint32_t EntropyBase::generateSeed() {
+  std::random_device rd;
+  return (uint32_t(rd()) << 16) ^ uint32_t(rd());
+}
+
+void EntropyBase::generateValues(Engine engine, uint32_t seed, float* values, int begin, int end) {
+  if (engine == COUNTER_ENGINE) {
+    for (int i = begin; i < end; ++i) {
+      values[i] = hash01(seed, (uint32_t)i);
+    }
+    return;
+  }
+
+  // Mersenne Twister values depend on every value before them
   std::mt19937 rng(seed);
   std::uniform_real_distribution<float> distribution(0.f, 1.f);
 
-  values.clear();
-  values.reserve(totalLength);
-  for (int i = 0; i < (int)totalLength; ++i) {
-    values.push_back(distribution(rng));
+  for (int i = 0; i < end; ++i) {
+    float value = distribution(rng);
+    if (i >= begin) {
+      values[i] = value;
+    }
   }
 }
 
 json_t* EntropyBase::dataToJson() {
   json_t* root = json_object();
 
-  json_t* valuesJson = json_array();
-  for (auto& value : values) {
-    json_array_append_new(valuesJson, json_real(value));
+  // Endless values come from the seed and pages alone
+  if (!isEndless) {
+    json_object_update(root, valuesToJson());
+  }
+  json_object_set_new(root, "seed", json_integer(seed.load()));
+  json_object_set_new(root, "engine", json_integer(getEngine()));
+  json_object_set_new(root, "index", json_integer(index.load()));
+
+  json_t* indicesJson = json_array();
+  for (int c = 0; c < MAX_CHANNELS; c++) {
+    json_array_append_new(indicesJson, json_integer((int)indices[c / 4][c % 4]));
+  }
+  json_object_set_new(root, "indices", indicesJson);
+
+  json_object_set_new(root, "endless", json_boolean(isEndless));
+  json_object_set_new(root, "skipFiltered", json_boolean(isSkipFiltered));
+
+  json_t* pagesJson = json_array();
+  for (uint32_t page : pages) {
+    json_array_append_new(pagesJson, json_integer(page));
   }
-  json_object_set_new(root, "values", valuesJson);
-  json_object_set_new(root, "seed", json_integer(seed));
-  json_object_set_new(root, "index", json_integer(index));
+  json_object_set_new(root, "pages", pagesJson);
+
+  json_object_set_new(root, "controlRate", json_integer(getControlRate()));
 
   return root;
 }
 
+// The keys that save the values, shared with root by dataToJson
+json_t* EntropyBase::valuesToJson() {
+  // Read before the values, so a change in between is saved next time rather than missed
+  uint32_t version = values.getVersion();
+  uint32_t seed = this->seed;
+  Engine engine = getEngine();
+  if (savedValuesJson && version == savedValuesVersion && seed == savedSeed && engine == savedEngine) {
+    return savedValuesJson;
+  }
+
+  if (savedValuesJson) {
+    json_decref(savedValuesJson);
+  }
+  savedValuesJson = json_object();
+  savedValuesVersion = version;
+  savedSeed = seed;
+  savedEngine = engine;
+
+  const float* currentValues = values.read(ValuePool::UI_READER);
+  if (json_t* overridesJson = overridesToJson(currentValues)) {
+    json_object_set_new(savedValuesJson, "overrides", overridesJson);
+  } else {
+    json_object_set_new(savedValuesJson, "values", json_string(encodeValues(currentValues, totalLength).c_str()));
+    json_object_set_new(savedValuesJson, "valuesEncoding", json_string(VALUES_ENCODING.c_str()));
+  }
+  return savedValuesJson;
+}
+
+// Pools that are mostly what the seed generates are saved as the seed and the values that differ
+// from it, as [index, value] pairs - or null if the pool has to be saved in full
+// Only counter-based values are generated the same everywhere, so Mersenne Twister pools are always
+// saved in full, as a patch could load with a different standard library
+json_t* EntropyBase::overridesToJson(const float* values) {
+  if (getEngine() != COUNTER_ENGINE) {
+    return nullptr;
+  }
+
+  std::vector<float> generatedValues(totalLength);
+  generateValues(COUNTER_ENGINE, seed, generatedValues.data(), 0, totalLength);
+
+  json_t* overridesJson = json_array();
+  int overrides = 0;
+  for (int i = 0; i < totalLength; i++) {
+    // Compared bit for bit, so a -0 edit over a generated 0 is kept
+    if (isSameBits(values[i], generatedValues[i])) {
+      continue;
+    }
+
+    // Pools from the values editor or GitHub share little with the seed
+    if (++overrides > totalLength / 4 || !isSavedExactly(values[i])) {
+      json_decref(overridesJson);
+      return nullptr;
+    }
+
+    json_t* overrideJson = json_array();
+    json_array_append_new(overrideJson, json_integer(i));
+    json_array_append_new(overrideJson, json_real(values[i]));
+    json_array_append_new(overridesJson, overrideJson);
+  }
+  return overridesJson;
+}
+
 void EntropyBase::dataFromJson(json_t* root) {
+  if (json_t* endlessJson = json_object_get(root, "endless")) {
+    setEndless(json_is_true(endlessJson));
+  }
+
+  if (json_t* skipFilteredJson = json_object_get(root, "skipFiltered")) {
+    setSkipFiltered(json_is_true(skipFilteredJson));
+  }
+
+  if (json_t* pagesJson = json_object_get(root, "pages")) {
+    if (json_is_array(pagesJson)) {
+      size_t c;
+      json_t* pageJson;
+      json_array_foreach(pagesJson, c, pageJson) {
+        if (json_is_integer(pageJson) && c < MAX_CHANNELS) {
+          pages[c] = (uint32_t)json_integer_value(pageJson);
+        }
+      }
+    }
+  }
+
+  if (json_t* controlRateJson = json_object_get(root, "controlRate")) {
+    if (json_is_integer(controlRateJson)) {
+      setControlRate((int)json_integer_value(controlRateJson));
+    }
+  }
+
   if (json_t* valuesJson = json_object_get(root, "values")) {
-    if (json_is_array(valuesJson)) {
-      values.clear();
+    json_t* encodingJson = json_object_get(root, "valuesEncoding");
+    if (json_is_string(valuesJson) && json_is_string(encodingJson) && json_string_value(encodingJson) == VALUES_ENCODING) {
+      try {
+        values.assign(decodeValues(json_string_value(valuesJson)));
+        hasLoadedValues = true;
+      } catch (...) {
+      }
+    } else if (json_is_array(valuesJson)) {
+      // Older patches have a JSON number per value
+      std::vector<float> newValues;
+      newValues.reserve(json_array_size(valuesJson));
       size_t index;
       json_t* valueJson;
       json_array_foreach(valuesJson, index, valueJson) {
         if (json_is_number(valueJson)) {
-          values.push_back((float)json_number_value(valueJson));
+          newValues.push_back((float)json_number_value(valueJson));
         }
       }
+      values.assign(newValues);
+      hasLoadedValues = true;
     }
   }
 
   if (json_t* seedJson = json_object_get(root, "seed")) {
     if (json_is_integer(seedJson)) {
       seed = (uint32_t)json_integer_value(seedJson);
+      endlessVersion++;
+    }
+  }
+
+  // Set directly, as setEngine would regenerate the loaded values
+  if (json_t* engineJson = json_object_get(root, "engine")) {
+    if (json_is_integer(engineJson)) {
+      int engine = (int)json_integer_value(engineJson);
+      if (engine >= 0 && engine < NUM_ENGINES) {
+        this->engine = engine;
+        values.discardNext();
+      }
+    }
+  }
+
+  // Needs the seed and engine loaded first
+  if (json_t* overridesJson = json_object_get(root, "overrides")) {
+    if (json_is_array(overridesJson)) {
+      Engine engine = getEngine();
+      uint32_t seed = this->seed;
+      values.write([&](float* values) {
+        generateValues(engine, seed, values, 0, totalLength);
+
+        size_t i;
+        json_t* overrideJson;
+        json_array_foreach(overridesJson, i, overrideJson) {
+          json_t* indexJson = json_array_get(overrideJson, 0);
+          json_t* valueJson = json_array_get(overrideJson, 1);
+          if (json_is_integer(indexJson) && json_is_number(valueJson)) {
+            int index = (int)json_integer_value(indexJson);
+            if (index >= 0 && index < totalLength) {
+              values[index] = (float)json_number_value(valueJson);
+            }
+          }
+        }
+      });
+      hasLoadedValues = true;
     }
   }
 
   if (json_t* currentIndexJson = json_object_get(root, "index")) {
     if (json_is_integer(currentIndexJson)) {
-      index = (int)json_integer_value(currentIndexJson);
+      setIndex(math::clamp((int)json_integer_value(currentIndexJson), 0, totalLength - 1));
+    }
+  }
+
+  // Clamped, as wrapped ranges only bring indices back from one step outside the pool
+  if (json_t* indicesJson = json_object_get(root, "indices")) {
+    if (json_is_array(indicesJson)) {
+      size_t c;
+      json_t* indexJson;
+      json_array_foreach(indicesJson, c, indexJson) {
+        if (json_is_integer(indexJson) && c < MAX_CHANNELS) {
+          indices[c / 4][c % 4] = (float)math::clamp((int)json_integer_value(indexJson), 0, totalLength - 1);
+        }
+      }
     }
   }
 }
@@ -1,14 +1,72 @@
 #pragma once
 
+#include "ValuePool.hpp"
+#include "../../helpers/JobPool.hpp"
+
 #include <rack.hpp>
 
+#include <array>
+#include <atomic>
+#include <memory>
 #include <vector>
 
 struct EntropyBase : rack::Module {
-  EntropyBase(int totalLength);
+  static constexpr int MAX_CHANNELS = 16;
+  static constexpr uint32_t DEFAULT_SEED = 42u;
+
+  enum Engine {
+    // std::mt19937, which must generate every value in order, and may differ between compilers
+    MERSENNE_TWISTER_ENGINE,
+    // A hash of the seed and index, so values can be generated individually
+    COUNTER_ENGINE,
+    NUM_ENGINES
+  };
+
+  // Storage is sized by totalLength, and is provided by EntropyModule
+  EntropyBase(int totalLength, float* valueStorage, float* endlessStorage, int* indexStorage);
+  ~EntropyBase();
   bool isInRange(int index) const;
   void randomizeSeed();
   void randomizeValues();
+  // Restores values in the current range from the seed, undoing edits
+  void restoreRange();
+
+  Engine getEngine();
+  void setEngine(Engine engine);
+
+  // Fills values[begin..end) with what the seed generates at those indices
+  static void generateValues(Engine engine, uint32_t seed, float* values, int begin, int end);
+
+  // In endless mode nothing is stored - values are hashed from the seed and position on demand,
+  // and every time a channel reaches the end of its sequence it moves on to the next page of a
+  // 2^32 value pool, so sequences don't repeat
+  bool getEndless();
+  void setEndless(bool isEndless);
+
+  // Playheads jump straight to the next step in their range that passes their filter, rather than
+  // stopping on filtered steps - not available in endless mode
+  bool getSkipFiltered();
+  void setSkipFiltered(bool isSkipFiltered);
+
+  // The stored values, or in endless mode the page channel 0 is on - UI thread only
+  const float* getDisplayValues();
+
+  // Versions only change when what they cover does, so the UI can skip work by comparing them
+  // against the last versions it saw - read the version before the state it covers
+  // Covers getDisplayValues
+  uint32_t getValuesVersion();
+  // Cover channel 0's range and filter - the playhead is drawn every frame, so has none
+  std::atomic<uint32_t> rangeVersion{0};
+  std::atomic<uint32_t> filterVersion{0};
+
+  // Keeps a randomized pool ready for the RANDOM trigger to swap in, generated in the background so
+  // neither the audio nor the UI thread has to - call regularly from the UI thread
+  void prepareRandomValues();
+
+  // Range and filter are re-evaluated every this many samples, and on every clock or reset
+  static const std::vector<int> CONTROL_RATES;
+  int getControlRate();
+  void setControlRate(int controlRate);
 
   enum ParamId {
     CLOCK_PARAM,
@@ -41,6 +99,7 @@ struct EntropyBase : rack::Module {
     TRIGGER_OUTPUT,
     GATE_OUTPUT,
     CV_OUTPUT,
+    DENSITY_OUTPUT,
     NUM_OUTPUTS
   };
 
@@ -55,57 +114,186 @@ struct EntropyBase : rack::Module {
     NUM_LIGHTS
   };
 
-  std::vector<float> values;
   const int totalLength;
-  int minIndex = 0;
-  int index = 0;
-  int maxIndex = 0; // max is somehat misleading, as it can wrap
-  float minValue = 0;
-  float maxValue = 0;
+  ValuePool values;
+
+  // Channel 0's playhead, range, and filter, for display
+  std::atomic<int> minIndex{0};
+  std::atomic<int> index{0};
+  std::atomic<int> maxIndex{0}; // max is somehat misleading, as it can wrap
+  std::atomic<float> minValue{0.f};
+  std::atomic<float> maxValue{0.f};
+  std::atomic<uint32_t> page{0};
+
+  // Steps in channel 0's range that pass its filter, and their share of the range - in endless mode
+  // the count is -1, and the share is what the filter passes on average - UI thread only
+  void countActiveSteps(int& count, float& density);
 
-  uint32_t seed = 42u;
+  std::atomic<uint32_t> seed{DEFAULT_SEED};
+
+  // Cancels background jobs when the module is destroyed, waiting for those submitted with it that
+  // are already running - jobs whose work uses the module must be submitted with it, while jobs
+  // that only call back into it can use a token created from it
+  std::shared_ptr<JobPool::Token> jobToken = JobPool::createToken();
 
 private:
+  // Checks the tables and trees below against recomputations - see tests/engine.cpp
+  friend struct EntropyBaseTest;
+
+  using float_4 = rack::simd::float_4;
+
+  // Playheads are processed four channels at a time
+  static constexpr int MAX_GROUPS = MAX_CHANNELS / 4;
+
+  void onAdd(const AddEvent& e) override;
   void onRandomize() override;
   void onReset() override;
 
+  // Runs on the audio thread, so must not allocate, lock, or make system calls - anything that
+  // needs to goes through ValuePool or is handed off to the UI thread, like prepareRandomValues
+  // `make test-realtime` fails if it does
   void process(const ProcessArgs& args) override;
-  void updateFilter();
+  int getChannels();
+  void updateTriggers(int c, bool isRunning, bool clockPressed, bool resetPressed, float_4& didStep, float_4& didReset);
+  void updateFilter(int c);
   bool updateRun();
   void updateValues(const ProcessArgs& args);
-  bool updateRange();
-  void updateIndex(const ProcessArgs& args, bool isRunning, bool isReversed);
+  void updateRange(int c);
+  void updateIndex(const ProcessArgs& args, int c, float_4 didStep, float_4 didReset);
+  void updateGateOutput(const ProcessArgs& args, int c, float_4 value, float_4 didStep);
+  void updateDisplay();
+  void updateActiveSteps(int c, int channels);
+  void sortValues();
+  void updatePassingIndices(int c);
+  int updatePassingIndex(int c, int index, bool isPassing);
+  void skipFilteredSteps(int c, float_4 lanes, float_4& didEnd);
+  int findPassingIndex(int c, int index);
 
-  float timeSinceLastClock = 0.f;
-  bool hasStepped = false;
-  bool isGateActive = false;
-  float gateTime = 0.f;
-  float maxGateTime = 0.f;
-  void updateGateOutput(const ProcessArgs& args, float value, bool didStep);
+  float_4 getValue(int c);
+  float_4 scaleValue(float_4 value);
 
-  float getValue();
-  float scaleValue(float value);
-
-  bool clampIndex(bool isReversed);
-  int clampRangeIndex(int index);
+  float_4 clampIndex(int c);
+  float_4 clampRangeIndex(float_4 index);
+  static float_4 isInRange(float_4 index, float_4 minIndex, float_4 maxIndex);
+  void setIndex(int index);
 
   json_t* dataToJson() override;
   void dataFromJson(json_t* root) override;
+  json_t* overridesToJson(const float* values);
+  json_t* valuesToJson();
+
+  // Per-channel state, one float_4 per group of four channels
+  // Indices are whole numbers stored as floats, which is exact well beyond any pool length
+  float_4 indices[MAX_GROUPS] = {};
+  float_4 minIndices[MAX_GROUPS] = {};
+  float_4 maxIndices[MAX_GROUPS] = {};
+  float_4 isReversed[MAX_GROUPS] = {};
+  float_4 minValues[MAX_GROUPS] = {};
+  float_4 maxValues[MAX_GROUPS] = {};
+  float_4 cvs[MAX_GROUPS] = {};
+
+  float_4 timeSinceLastClock[MAX_GROUPS] = {};
+  float_4 hasStepped[MAX_GROUPS] = {};
+  float_4 gateTime[MAX_GROUPS] = {};
+  float_4 maxGateTime[MAX_GROUPS] = {};
+
+  rack::dsp::TSchmittTrigger<float_4> clockTriggers[MAX_GROUPS];
+  rack::dsp::TSchmittTrigger<float_4> resetTriggers[MAX_GROUPS];
+  rack::dsp::TPulseGenerator<float_4> eosPulses[MAX_GROUPS];
+  rack::dsp::TPulseGenerator<float_4> triggerPulses[MAX_GROUPS];
+
+  // Read once per process call
+  const float* audioValues = nullptr;
+  uint32_t audioValuesVersion = 0;
+
+  static uint32_t generateSeed();
+
+  std::atomic<int> engine{MERSENNE_TWISTER_ENGINE};
+
+  std::atomic<bool> isEndless{false};
+  uint32_t pages[MAX_CHANNELS] = {};
+  float* endlessValues;
+  // Bumped when endless values change without the pool changing
+  std::atomic<uint32_t> endlessVersion{0};
+  // What endlessValues were last hashed for
+  bool hasEndlessValues = false;
+  uint32_t endlessValuesVersion = 0;
+
+  std::atomic<bool> isSkipFiltered{false};
+  // For each channel and index, the first index on from it that passes the channel's filter, going
+  // forwards in nextPassing and backwards in previousPassing, wrapping around the pool - or -1 if
+  // none do - so skipping is constant time per step
+  int* nextPassing;
+  int* previousPassing;
+  // Which passChanges each channel's tables are up to date with
+  uint32_t passingChanges[MAX_CHANNELS] = {};
+
+  // For each channel, a Fenwick tree of which indices pass its filter, so active steps can be
+  // counted over any range in O(log n)
+  int* activeCounts;
+  // Indices in value order, so when a filter moves only the values it moved past are visited
+  int* sortedIndices;
+  uint32_t sortedVersion = 0;
+  // What each channel's tree was last updated for, and how often which indices pass has changed
+  uint32_t activeVersions[MAX_CHANNELS] = {};
+  float activeMinValues[MAX_CHANNELS] = {};
+  float activeMaxValues[MAX_CHANNELS] = {};
+  uint32_t passChanges[MAX_CHANNELS] = {};
+  float_4 densities[MAX_GROUPS] = {};
+
+  std::atomic<bool> isPreparingNext{false};
+  // Set when the RANDOM trigger fires before the next values are ready
+  std::atomic<bool> isRandomizePending{false};
+
+  // Set when dataFromJson supplies values, so onAdd needn't generate any
+  bool hasLoadedValues = false;
+
+  // What dataToJson last saved the values as, reused by autosaves until they, the seed, or the
+  // engine change
+  json_t* savedValuesJson = nullptr;
+  uint32_t savedValuesVersion = 0;
+  uint32_t savedSeed = 0;
+  Engine savedEngine = MERSENNE_TWISTER_ENGINE;
+
+  rack::dsp::ClockDivider controlDivider;
+  int lastChannels = 0;
+
+  // Lights show activity on any channel
+  int eosMask = 0;
+  int triggerMask = 0;
+  int gateMask = 0;
 
   rack::dsp::SchmittTrigger clockButtonTrigger;
-  rack::dsp::SchmittTrigger clockTrigger;
   rack::dsp::PulseGenerator clockPulse;
 
   rack::dsp::SchmittTrigger runTrigger;
 
   rack::dsp::SchmittTrigger resetButtonTrigger;
-  rack::dsp::SchmittTrigger resetTrigger;
   rack::dsp::PulseGenerator resetPulse;
 
   rack::dsp::SchmittTrigger randomButtonTrigger;
   rack::dsp::SchmittTrigger randomTrigger;
   rack::dsp::PulseGenerator randomPulse;
+};
+
+// Everything sized by the pool length, so it can live inline in the module rather than on the heap
+template <int LENGTH>
+struct EntropyStorage {
+  ValuePool::Storage<LENGTH> valueStorage;
+  std::array<float, LENGTH> endlessStorage;
+  std::array<int, (3 * EntropyBase::MAX_CHANNELS + 1) * LENGTH> indexStorage;
+};
 
-  rack::dsp::PulseGenerator eosPulse;
-  rack::dsp::PulseGenerator triggerPulse;
+// An EntropyBase with a pool length fixed at compile time
+// Storage is inherited first so it is constructed before EntropyBase uses it
+template <int LENGTH>
+struct EntropyModule : private EntropyStorage<LENGTH>, EntropyBase {
+  EntropyModule()
+    : EntropyBase(
+      LENGTH,
+      EntropyStorage<LENGTH>::valueStorage.data(),
+      EntropyStorage<LENGTH>::endlessStorage.data(),
+      EntropyStorage<LENGTH>::indexStorage.data()
+    )
+  {}
 };
@@ -2,9 +2,14 @@
 #include "GitHubModal.hpp"
 #include "SeedModal.hpp"
 #include "ValuesModal.hpp"
+#include "../../helpers/JobPool.hpp"
 
 #include "../../plugin.hpp"
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 using namespace rack;
 
 EntropyBaseWidget::EntropyBaseWidget(EntropyBase* module, std::string svgPath) {
@@ -17,6 +22,17 @@ EntropyBaseWidget::EntropyBaseWidget(EntropyBase* module, std::string svgPath) {
   addChild(createWidget<ScrewBlack>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
 }
 
+void EntropyBaseWidget::step() {
+  ModuleWidget::step();
+
+  JobPool::get().runCompletions();
+
+  EntropyBase* module = getModule<EntropyBase>();
+  if (module) {
+    module->prepareRandomValues();
+  }
+}
+
 void EntropyBaseWidget::appendContextMenu(ui::Menu* menu) {
   ModuleWidget::appendContextMenu(menu);
 
@@ -38,4 +54,50 @@ void EntropyBaseWidget::appendContextMenu(ui::Menu* menu) {
   menu->addChild(createMenuItem("Use GitHub activity...", "", [=]() {
     new GitHubModal(module);
   }));
+
+  menu->addChild(createMenuItem("Restore range from seed", "", [=]() {
+    module->restoreRange();
+  }));
+
+  menu->addChild(createBoolMenuItem("Endless pool", "",
+    [=]() {
+      return module->getEndless();
+    },
+    [=](bool isEndless) {
+      module->setEndless(isEndless);
+    }
+  ));
+
+  menu->addChild(createBoolMenuItem("Skip filtered steps", "",
+    [=]() {
+      return module->getSkipFiltered();
+    },
+    [=](bool isSkipFiltered) {
+      module->setSkipFiltered(isSkipFiltered);
+    }
+  ));
+
+  menu->addChild(createIndexSubmenuItem("Random engine", {"Mersenne Twister", "Counter-based"},
+    [=]() {
+      return (size_t)module->getEngine();
+    },
+    [=](size_t engine) {
+      module->setEngine((EntropyBase::Engine)engine);
+    }
+  ));
+
+  std::vector<std::string> controlRateLabels;
+  for (int controlRate : EntropyBase::CONTROL_RATES) {
+    controlRateLabels.push_back(controlRate == 1 ? "Every sample" : string::f("Every %i samples", controlRate));
+  }
+
+  menu->addChild(createIndexSubmenuItem("Range and filter rate", controlRateLabels,
+    [=]() {
+      auto it = std::find(EntropyBase::CONTROL_RATES.begin(), EntropyBase::CONTROL_RATES.end(), module->getControlRate());
+      return (size_t)(it - EntropyBase::CONTROL_RATES.begin());
+    },
+    [=](size_t i) {
+      module->setControlRate(EntropyBase::CONTROL_RATES[i]);
+    }
+  ));
 }
@@ -7,5 +7,6 @@
 struct EntropyBaseWidget : rack::app::ModuleWidget {
   EntropyBaseWidget(EntropyBase* module, std::string svgPath);
 
+  void step() override;
   void appendContextMenu(rack::ui::Menu* menu) override;
 };
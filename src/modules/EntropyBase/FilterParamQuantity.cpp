@@ -1,17 +1,31 @@
 #include "FilterParamQuantity.hpp"
+#include "EntropyBase.hpp"
 
 using namespace rack;
 
 std::string FilterParamQuantity::getString() {
   float value = getValue();
 
+  std::string text;
   if (value == 0.f) {
-    return getLabel() + ": None";
+    text = getLabel() + ": None";
   } else if (value > 0.f) {
-    return getLabel() + string::f(" >= %.2f", value);
+    text = getLabel() + string::f(" >= %.2f", value);
   } else {
-    return getLabel() + string::f(" <= %.2f", value + 1);
+    text = getLabel() + string::f(" <= %.2f", value + 1);
   }
+
+  // What channel 0 is actually playing, including CV
+  EntropyBase* entropyModule = (EntropyBase*)module;
+  int activeSteps;
+  float density;
+  entropyModule->countActiveSteps(activeSteps, density);
+  if (activeSteps >= 0) {
+    text += string::f("\n%i active steps (%.0f%%)", activeSteps, density * 100.f);
+  } else {
+    text += string::f("\n%.0f%% active steps", density * 100.f);
+  }
+  return text;
 }
 
 std::string FilterParamQuantity::getDisplayValueString() {
@@ -0,0 +1,98 @@
+#include "GitHubCache.hpp"
+#include "../../helpers/hash.hpp"
+
+#include "../../plugin.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <cctype>
+#include <fstream>
+
+using namespace rack;
+
+namespace {
+  // Numbers each save's temporary file
+  std::atomic<uint32_t> saves{0};
+
+  std::string getPath(const std::string& key) {
+    return asset::user(pluginInstance->slug + "/github/" + key + ".json");
+  }
+
+  uint64_t hashString(const std::string& s) {
+    uint64_t stringHash = 0;
+    for (char c : s) {
+      stringHash = hash((uint32_t)(stringHash ^ (stringHash >> 32)), (uint8_t)c);
+    }
+    return stringHash;
+  }
+
+  std::string formatHash(const std::string& s) {
+    return string::f("%016llx", (unsigned long long)hashString(s));
+  }
+}
+
+bool GitHubCache::Entry::isFresh() const {
+  return system::getUnixTime() - fetchedAt < TTL;
+}
+
+std::string GitHubCache::getKey(const std::string& endpoint, const std::string& username, const std::string& token) {
+  std::string key;
+  if (!username.empty()) {
+    std::string safeUsername;
+    for (char c : username) {
+      safeUsername += std::isalnum((unsigned char)c) || c == '-' ? c : '_';
+    }
+    key = "user-" + safeUsername + "-";
+  } else {
+    key = "viewer-";
+  }
+  key += formatHash(token);
+
+  if (!endpoint.empty()) {
+    key += "-" + formatHash(endpoint);
+  }
+  return key;
+}
+
+bool GitHubCache::load(const std::string& key, Entry& entry) {
+  std::ifstream file(getPath(key));
+  if (!file) {
+    return false;
+  }
+
+  try {
+    nlohmann::json json = nlohmann::json::parse(file);
+    entry.fetchedAt = json.at("fetchedAt").get<double>();
+    entry.etag = json.at("etag").get<std::string>();
+    entry.years = json.value("years", 1);
+    entry.counts = json.at("counts").get<std::vector<int>>();
+    entry.weekdays = json.at("weekdays").get<std::vector<int>>();
+    return entry.counts.size() == entry.weekdays.size();
+  } catch (...) {
+    return false;
+  }
+}
+
+// Written to a temporary file and renamed into place, so a crash can't leave half an entry - one
+// per save, as the job pool's workers can save the same key at once
+void GitHubCache::save(const std::string& key, const Entry& entry) {
+  nlohmann::json json = {
+    {"fetchedAt", entry.fetchedAt},
+    {"etag", entry.etag},
+    {"years", entry.years},
+    {"counts", entry.counts},
+    {"weekdays", entry.weekdays}
+  };
+
+  std::string path = getPath(key);
+  std::string tempPath = path + string::f(".%u.tmp", (unsigned)saves++);
+  system::createDirectories(system::getDirectory(path));
+  {
+    std::ofstream file(tempPath);
+    if (!file || !(file << json.dump())) {
+      return;
+    }
+  }
+  system::rename(tempPath, path);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Contribution history saved under the Rack user folder, so repeated loads don't need the network,
+// and offline rigs can fall back to the last good data
+struct GitHubCache {
+  // Fresh entries are used without asking GitHub at all
+  static constexpr double TTL = 6 * 60 * 60;
+
+  struct Entry {
+    double fetchedAt = 0;
+    std::string etag;
+    // Of history, for the lengths it can fill
+    int years = 1;
+    // One per day, oldest first
+    std::vector<int> counts;
+    std::vector<int> weekdays;
+
+    bool isFresh() const;
+  };
+
+  // Per username and token, so a wrong or different token never gets another's entry, only a
+  // hash of it - tokens themselves are never written
+  // Endpoints other than GitHub's own (empty) get entries of their own
+  static std::string getKey(const std::string& endpoint, const std::string& username, const std::string& token);
+  static bool load(const std::string& key, Entry& entry);
+  static void save(const std::string& key, const Entry& entry);
+};
@@ -6,114 +6,305 @@
 #include <nlohmann/json.hpp>
 #include <rack.hpp>
 
-#include <thread>
+#include <cstdlib>
 
 using namespace rack;
 
 namespace {
-  void fail(GitHubIntegration::Callback callback, std::string error) {
-    callback(GitHubIntegration::Result{false, error, {}});
+  GitHubIntegration::Result fail(std::string error) {
+    return GitHubIntegration::Result{false, error, {}};
   }
-}
 
-void GitHubIntegration::fetchNormalizedContributions(std::string nameAndToken, int length, bool includeWeekends, Callback callback) {
-  std::thread([=] {
-    try {
-      size_t atPos = nameAndToken.find('@');
-      size_t splitIndex = (atPos == std::string::npos) ? 0 : atPos + 1;
-      std::string username = (atPos == std::string::npos) ? "" : nameAndToken.substr(0, atPos);
-      std::string token = nameAndToken.substr(splitIndex);
-
-      if (token.empty()) {
-        fail(callback, "Token is required");
-        return;
+  // Picks each day's count and weekday straight out of the response as it is parsed, without
+  // building a document - everything else is skipped
+  struct ContributionsParser : nlohmann::json_sax<nlohmann::json> {
+    std::vector<int>& counts;
+    std::vector<int>& weekdays;
+    int calendars = 0;
+
+    ContributionsParser(std::vector<int>& counts, std::vector<int>& weekdays)
+      : counts(counts),
+        weekdays(weekdays)
+    {}
+
+    bool key(string_t& key) override {
+      field = key == "contributionCount" ? COUNT_FIELD : key == "weekday" ? WEEKDAY_FIELD : NO_FIELD;
+      if (key == "contributionCalendar") {
+        calendars++;
       }
+      return true;
+    }
 
-      httplib::SSLClient client("api.github.com");
-      httplib::Headers headers = {
-        {"Authorization", "Bearer " + token},
-        {"Content-Type", "application/json"},
-        {"User-Agent", "cpp-httplib-plugin"}
-      };
-
-      std::string header, requestScope, responseScope;
-      if (username.empty()) {
-        header = "query";
-        requestScope = "viewer";
-        responseScope = "viewer";
-      } else {
-        header = "query($username: String!)";
-        requestScope = "user(login: $username)";
-        responseScope = "user";
+    bool number_integer(number_integer_t value) override {
+      return setField((int)value);
+    }
+
+    bool number_unsigned(number_unsigned_t value) override {
+      return setField((int)value);
+    }
+
+    // Days are the only objects with both fields
+    bool end_object() override {
+      if (count >= 0 && weekday >= 0) {
+        counts.push_back(count);
+        weekdays.push_back(weekday);
+      }
+      count = -1;
+      weekday = -1;
+      return skip();
+    }
+
+    bool null() override { return skip(); }
+    bool boolean(bool) override { return skip(); }
+    bool number_float(number_float_t, const string_t&) override { return skip(); }
+    bool string(string_t&) override { return skip(); }
+    bool binary(binary_t&) override { return skip(); }
+    bool start_object(std::size_t) override { return skip(); }
+    bool start_array(std::size_t) override { return skip(); }
+    bool end_array() override { return skip(); }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) override {
+      return false;
+    }
+
+  private:
+    enum Field {
+      NO_FIELD,
+      COUNT_FIELD,
+      WEEKDAY_FIELD
+    };
+    Field field = NO_FIELD;
+    int count = -1;
+    int weekday = -1;
+
+    bool setField(int value) {
+      if (field == COUNT_FIELD) {
+        count = value;
+      } else if (field == WEEKDAY_FIELD) {
+        weekday = value;
       }
+      return skip();
+    }
+
+    bool skip() {
+      field = NO_FIELD;
+      return true;
+    }
+  };
+
+  // A calendar can't span more than a year, so longer histories are fetched a year at a time
+  constexpr int DAYS_PER_YEAR = 365;
+  constexpr int MAX_YEARS = 10;
+
+  int getYears(int length, bool includeWeekends) {
+    int days = includeWeekends ? length : (length * 7 + 4) / 5;
+    return math::clamp((days + DAYS_PER_YEAR - 1) / DAYS_PER_YEAR, 1, MAX_YEARS);
+  }
+
+  // Days since the epoch to a UTC date, without gmtime, which isn't thread safe everywhere
+  std::string formatDate(int64_t day) {
+    int64_t z = day + 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int64_t dayOfEra = z - era * 146097;
+    int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int64_t monthIndex = (5 * dayOfYear + 2) / 153;
+    int dayOfMonth = (int)(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+    int month = (int)(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+    int year = (int)(yearOfEra + era * 400 + (month <= 2 ? 1 : 0));
+    return string::f("%04d-%02d-%02d", year, month, dayOfMonth);
+  }
 
-      std::string query = "contributionsCollection { contributionCalendar { weeks { contributionDays { contributionCount weekday } } } }";
-      std::string body = header + " { " + requestScope + " { " + query + " } }";
+  // One aliased collection per year, oldest first so the days come back in order, with no days
+  // shared between neighbouring years
+  std::string getCollectionsQuery(int years) {
+    std::string calendar = "contributionCalendar { weeks { contributionDays { contributionCount weekday } } }";
+    int64_t today = (int64_t)std::floor(system::getUnixTime() / 86400);
 
-      nlohmann::json jsonBody;
-      jsonBody["query"] = body;
-      if (!username.empty()) {
-        jsonBody["variables"] = {{"username", username}};
+    std::string query;
+    for (int y = years - 1; y >= 0; --y) {
+      int64_t lastDay = today - (int64_t)y * DAYS_PER_YEAR;
+      int64_t firstDay = lastDay - DAYS_PER_YEAR + 1;
+      query += string::f(
+        "year%i: contributionsCollection(from: \"%sT00:00:00Z\", to: \"%sT23:59:59Z\") { %s } ",
+        y, formatDate(firstDay).c_str(), formatDate(lastDay).c_str(), calendar.c_str()
+      );
+    }
+    return query;
+  }
+
+  constexpr const char* DEFAULT_ENDPOINT = "https://api.github.com/graphql";
+
+  // The GraphQL endpoint can be swapped for a local stand-in with an environment variable, like
+  // SPORKBOMB_GITHUB_ENDPOINT=http://localhost:8080/graphql
+  struct Endpoint {
+    std::string url;
+    // Scheme, host, and port, as httplib takes them
+    std::string origin;
+    std::string path;
+  };
+
+  const Endpoint& getEndpoint() {
+    static const Endpoint endpoint = [] {
+      const char* env = std::getenv("SPORKBOMB_GITHUB_ENDPOINT");
+      std::string url = (env && *env) ? env : DEFAULT_ENDPOINT;
+
+      size_t schemeEnd = url.find("://");
+      size_t pathStart = url.find('/', schemeEnd == std::string::npos ? 0 : schemeEnd + 3);
+      if (pathStart == std::string::npos) {
+        return Endpoint{url, url, "/graphql"};
       }
+      return Endpoint{url, url.substr(0, pathStart), url.substr(pathStart)};
+    }();
+    return endpoint;
+  }
+}
 
-      if (auto res = client.Post("/graphql", headers, jsonBody.dump(), "application/json")) {
-        if (res->status == 200) {
-          try {
-            auto json = nlohmann::json::parse(res->body);
-            auto calendar = json.at("data").at(responseScope).at("contributionsCollection").at("contributionCalendar");
-            auto normalizedContributions = normalizeContributions(calendar, length, includeWeekends);
-            callback(GitHubIntegration::Result{true, "", normalizedContributions});
-          } catch (...) {
-            DEBUG("%s", res->body.c_str());
-            fail(callback, "Parsing error");
-          }
-        } else if (res->status == 401) {
-          fail(callback, "Bad token (401)");
-        } else if (res->status == 403) {
-          fail(callback, "Unauthorized (403)");
-        } else if (res->status >= 500) {
-          fail(callback, string::f("API error (%i)", res->status));
-        } else if (res->status >= 400) {
-          fail(callback, string::f("Request error (%i)", res->status));
-        } else {
-          fail(callback, string::f("Error (%i)", res->status));
+void GitHubIntegration::fetchNormalizedContributions(std::string nameAndToken, int length, bool includeWeekends, std::shared_ptr<JobPool::Token> token, Callback callback) {
+  bool isSubmitted = JobPool::get().submit(token, [=]() {
+    Result result = fetch(nameAndToken, length, includeWeekends);
+    return [=]() {
+      callback(result);
+    };
+  });
+
+  if (!isSubmitted) {
+    callback(fail("Too many requests in progress"));
+  }
+}
+
+GitHubIntegration::Result GitHubIntegration::fetch(std::string nameAndToken, int length, bool includeWeekends) {
+  try {
+    size_t atPos = nameAndToken.find('@');
+    size_t splitIndex = (atPos == std::string::npos) ? 0 : atPos + 1;
+    std::string username = (atPos == std::string::npos) ? "" : nameAndToken.substr(0, atPos);
+    std::string token = nameAndToken.substr(splitIndex);
+
+    if (token.empty()) {
+      return fail("Token is required");
+    }
+
+    int years = getYears(length, includeWeekends);
+    const Endpoint& endpoint = getEndpoint();
+    std::string cacheKey = GitHubCache::getKey(endpoint.url == DEFAULT_ENDPOINT ? "" : endpoint.url, username, token);
+    GitHubCache::Entry cached;
+    bool isCached = GitHubCache::load(cacheKey, cached);
+    // Entries with fewer years than this length needs are only a fallback
+    bool isCacheLongEnough = isCached && cached.years >= years;
+    if (isCacheLongEnough && cached.isFresh()) {
+      return succeed(cached, length, includeWeekends);
+    }
+
+    // Short enough that a dead connection doesn't tie up a shared worker for minutes
+    httplib::Client client(endpoint.origin);
+    client.set_connection_timeout(10);
+    client.set_read_timeout(30);
+    httplib::Headers headers = {
+      {"Authorization", "Bearer " + token},
+      {"Content-Type", "application/json"},
+      {"User-Agent", "cpp-httplib-plugin"}
+    };
+    if (isCached && cached.years == years && !cached.etag.empty()) {
+      headers.emplace("If-None-Match", cached.etag);
+    }
+
+    std::string header, requestScope;
+    if (username.empty()) {
+      header = "query";
+      requestScope = "viewer";
+    } else {
+      header = "query($username: String!)";
+      requestScope = "user(login: $username)";
+    }
+
+    std::string body = header + " { " + requestScope + " { " + getCollectionsQuery(years) + "} }";
+
+    nlohmann::json jsonBody;
+    jsonBody["query"] = body;
+    if (!username.empty()) {
+      jsonBody["variables"] = {{"username", username}};
+    }
+
+    auto res = client.Post(endpoint.path, headers, jsonBody.dump(), "application/json");
+
+    // Offline, or GitHub is having trouble, where stale data beats none
+    if (isCached && (!res || res->status >= 500)) {
+      return succeed(cached, length, includeWeekends);
+    }
+
+    if (res) {
+      if (res->status == 304 && isCached && cached.years == years) {
+        cached.fetchedAt = system::getUnixTime();
+        GitHubCache::save(cacheKey, cached);
+        return succeed(cached, length, includeWeekends);
+      } else if (res->status == 200) {
+        GitHubCache::Entry entry;
+        if (!parseContributions(res->body, years, entry.counts, entry.weekdays)) {
+          DEBUG("%s", res->body.c_str());
+          return fail("Parsing error");
         }
+        entry.years = years;
+        entry.fetchedAt = system::getUnixTime();
+        entry.etag = res->get_header_value("ETag");
+        GitHubCache::save(cacheKey, entry);
+        return succeed(entry, length, includeWeekends);
+      } else if (res->status == 401) {
+        return fail("Bad token (401)");
+      } else if (res->status == 403) {
+        return fail("Unauthorized (403)");
+      } else if (res->status >= 500) {
+        return fail(string::f("API error (%i)", res->status));
+      } else if (res->status >= 400) {
+        return fail(string::f("Request error (%i)", res->status));
       } else {
-        fail(callback, "Failed");
+        return fail(string::f("Error (%i)", res->status));
       }
-    } catch (...) {
-      fail(callback, "Failed");
+    } else {
+      return fail("Failed");
     }
-  }).detach();
+  } catch (...) {
+    return fail("Failed");
+  }
 }
 
-std::vector<float> GitHubIntegration::normalizeContributions(const nlohmann::json& calendar, int length, bool includeWeekends) {
-  std::vector<int> contributions;
+GitHubIntegration::Result GitHubIntegration::succeed(const GitHubCache::Entry& entry, int length, bool includeWeekends) {
+  return GitHubIntegration::Result{true, "", normalizeContributions(entry.counts, entry.weekdays, length, includeWeekends)};
+}
+
+// Flattens the calendars into one count and weekday per day, oldest first
+bool GitHubIntegration::parseContributions(const std::string& body, int years, std::vector<int>& counts, std::vector<int>& weekdays) {
+  counts.reserve(years * DAYS_PER_YEAR);
+  weekdays.reserve(years * DAYS_PER_YEAR);
+
+  ContributionsParser parser(counts, weekdays);
+  return nlohmann::json::sax_parse(body, &parser) && parser.calendars == years;
+}
 
+// The most recent days fill the end of the values, and any left over at the start are zero
+// The most recent days that fit, oldest first, with any steps left over after them at 0
+std::vector<float> GitHubIntegration::normalizeContributions(const std::vector<int>& counts, const std::vector<int>& weekdays, int length, bool includeWeekends) {
+  auto isIncluded = [&](int d) {
+    return includeWeekends || (weekdays[d] != 0 && weekdays[d] != 6);
+  };
+
+  int first = (int)counts.size();
+  for (int days = 0; first > 0 && days < length; ) {
+    days += isIncluded(--first);
+  }
+
+  std::vector<float> values(length, 0.f);
   int maxValue = 0;
-  auto weeks = calendar.at("weeks");
-  for (int w = (int)weeks.size() - 1; w >= 0 && contributions.size() < (size_t)length; --w) {
-    const auto& days = weeks.at(w).at("contributionDays");
-    for (int d = (int)days.size() - 1; d >= 0 && contributions.size() < (size_t)length; --d) {
-      auto day = days.at(d);
-      int weekday = day.at("weekday").get<int>();
-      if (includeWeekends || (weekday != 0 && weekday != 6)) {
-        int value = days.at(d).at("contributionCount").get<int>();
-        contributions.push_back(value);
-        maxValue = std::max(value, maxValue);
-      }
+  int i = 0;
+  for (int d = first; d < (int)counts.size(); ++d) {
+    if (isIncluded(d)) {
+      values[i++] = (float)counts[d];
+      maxValue = std::max(counts[d], maxValue);
     }
   }
 
   float scale = maxValue == 0 ? 0.f : 1.f / (float)maxValue;
-
-  std::vector<float> values;
-  for (int i = contributions.size() - 1; i >= 0; --i) {
-    values.push_back((float)contributions[i] * scale);
-  }
-
-  while (values.size() < (size_t)length) {
-    values.push_back(0);
+  for (float& value : values) {
+    value *= scale;
   }
 
   return values;
@@ -1,8 +1,10 @@
 #pragma once
 
-#include <nlohmann/json_fwd.hpp>
+#include "GitHubCache.hpp"
+#include "../../helpers/JobPool.hpp"
 
 #include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -15,8 +17,12 @@ struct GitHubIntegration {
 
   using Callback = std::function<void(Result)>;
 
-  static void fetchNormalizedContributions(std::string nameAndToken, int length, bool includeWeekends, Callback callback);
+  // Fetches in the background, and calls back on the UI thread unless token is cancelled first
+  static void fetchNormalizedContributions(std::string nameAndToken, int length, bool includeWeekends, std::shared_ptr<JobPool::Token> token, Callback callback);
 
 private:
-  static std::vector<float> normalizeContributions(const nlohmann::json& contributions, int length, bool includeWeekends);
+  static Result fetch(std::string nameAndToken, int length, bool includeWeekends);
+  static Result succeed(const GitHubCache::Entry& entry, int length, bool includeWeekends);
+  static bool parseContributions(const std::string& body, int years, std::vector<int>& counts, std::vector<int>& weekdays);
+  static std::vector<float> normalizeContributions(const std::vector<int>& counts, const std::vector<int>& weekdays, int length, bool includeWeekends);
 };
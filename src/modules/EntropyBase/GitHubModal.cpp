@@ -2,9 +2,7 @@
 #include "GitHubModal.hpp"
 #include "TextFieldContainer.hpp"
 
-#include <chrono>
 #include <string>
-#include <thread>
 #include <vector>
 
 using namespace rack;
@@ -39,15 +37,27 @@ GitHubModal::GitHubModal(EntropyBase* module)
   addChild(statusLabel);
 }
 
+GitHubModal::~GitHubModal() {
+  if (fetchToken) {
+    fetchToken->cancel();
+  }
+}
+
 bool GitHubModal::onSave() {
   statusLabel->color = nvgRGB(255, 255, 255);
   statusLabel->text = "Loading...";
 
+  // Only the latest save's result is wanted
+  if (fetchToken) {
+    fetchToken->cancel();
+  }
+  fetchToken = JobPool::createToken(module->jobToken);
+
   GitHubIntegration::fetchNormalizedContributions(
-    tokenField->text, module->totalLength, weekendsCheckbox->value,
+    tokenField->text, module->totalLength, weekendsCheckbox->value, fetchToken,
     [=](GitHubIntegration::Result result) {
       if (result.success) {
-        module->values = result.values;
+        module->values.assign(result.values);
         Modal::close(this);
       } else {
         statusLabel->color = nvgRGB(255, 0, 0);
@@ -7,13 +7,18 @@
 
 #include <rack.hpp>
 
+#include <memory>
+
 struct GitHubModal : Modal {
   GitHubModal(EntropyBase* module);
+  ~GitHubModal();
 
   bool onSave() override;
 
 private:
   EntropyBase* module;
+  // Cancelled when the modal or module goes away, so a fetch in flight can't call back into either
+  std::shared_ptr<JobPool::Token> fetchToken;
   rack::ui::MenuLabel* text;
   rack::ui::Label* statusLabel;
   GitHubTokenField* tokenField;
@@ -5,6 +5,9 @@
 
 #include "nanovg.h"
 
+#include <cmath>
+#include <vector>
+
 using namespace rack;
 
 namespace {
@@ -16,6 +19,25 @@ namespace {
   const NVGcolor borderColor = nvgRGB(96, 96, 96);
   const NVGcolor capColor = nvgRGB(240, 246, 253);
   const NVGcolor dotColor = nvgRGB(240, 246, 253);
+
+  // Range and filter states, each with their own alpha buckets
+  const int NUM_ALPHA_BUCKETS = 16;
+  const int NUM_BATCHES = 4 * NUM_ALPHA_BUCKETS;
+
+  // Top left corner of a cell, in mm
+  math::Vec getCellPosition(int i, int rowLength, int itemWidth) {
+    const int x = gutterWidth + (i % rowLength) * (itemWidth + gutterWidth);
+    const int y = gutterWidth + (i / rowLength) * (itemWidth + gutterWidth);
+    return math::Vec(x, y);
+  }
+
+  // The cached part of the grid - everything but the playhead
+  struct GridCells : widget::TransparentWidget {
+    Grid* grid;
+    GridCells(Grid* grid) : grid(grid) {}
+
+    void draw(const DrawArgs& args) override;
+  };
 }
 
 Grid::Grid()
@@ -23,114 +45,224 @@ Grid::Grid()
 {
   tooltip->visible = false;
   APP->scene->addChild(tooltip);
+
+  framebuffer = new widget::FramebufferWidget();
+  framebuffer->addChild(new GridCells(this));
+  addChild(framebuffer);
 }
 
-void Grid::draw(const DrawArgs& args) {
-  for (int i = 0; i < length; i++) {
-    float value = module ? module->values[i] : defaultDistribution(defaultRng);
-    bool isFiltered = module ? module->maxValue < value || value < module->minValue : false;
-    bool isInRange = module ? module -> isInRange(i) : true;
+bool Grid::DrawnState::operator==(const DrawnState& other) const {
+  return
+    valuesVersion == other.valuesVersion &&
+    rangeVersion == other.rangeVersion &&
+    filterVersion == other.filterVersion;
+}
 
-    const NVGcolor color = isInRange
-      ? nvgRGBA(46, 160, 67, value * 255.f)
-      : nvgRGBA(96, 96, 96, value * 255.f);
+void Grid::step() {
+  if (!framebuffer->box.size.equals(box.size)) {
+    framebuffer->box.size = box.size;
+    for (Widget* child : framebuffer->children) {
+      child->box.size = box.size;
+    }
+    framebuffer->setDirty();
+  }
 
-    const int x = gutterWidth + (i % rowLength) * (itemWidth + gutterWidth);
-    const int y = gutterWidth + (i / rowLength) * (itemWidth + gutterWidth);
+  if (module) {
+    DrawnState state = {
+      module->getValuesVersion(),
+      module->rangeVersion,
+      module->filterVersion
+    };
 
-    if (isFiltered) {
-      nvgBeginPath(args.vg);
-      nvgRoundedRect(args.vg, mm2px(x + .2f), mm2px(y + .2f), mm2px(itemWidth - .4f), mm2px(itemWidth - .4f), rectRadius);
-      nvgStrokeColor(args.vg, color);
-      nvgStrokeWidth(args.vg, mm2px(.4f));
-      nvgStroke(args.vg);
-    } else {
-      nvgBeginPath(args.vg);
-      nvgRoundedRect(args.vg, mm2px(x), mm2px(y), mm2px(itemWidth), mm2px(itemWidth), rectRadius);
-      nvgFillColor(args.vg, color);
-      nvgFill(args.vg);
+    if (!(state == drawnState)) {
+      drawnState = state;
+      framebuffer->setDirty();
     }
 
-    if (!module || !isInRange) {
-      continue;
+    // Values can change under a still mouse
+    if (tooltip->visible) {
+      updateTooltip();
     }
+  }
 
-    const float top = mm2px(y - borderWidth);
-    const float right = mm2px(x + itemWidth + borderWidth);
-    const float bottom = mm2px(y + itemWidth + borderWidth);
-    const float left = mm2px(x - borderWidth);
-    const float cx = mm2px(x + itemWidth / 2.f);
-    const float cy = mm2px(y + itemWidth / 2.f);
-
-    // Range blob
-    // Maybe nice as a toggle, as it looks cool in normal cases, but is noisy and just kind of weird
-    // to deal with edge cases - left/right borders at edges of grid look odd... but losing the caps
-    // sucks in some cases? Also, should round the corners - but in the appropriate directions!
-    // nvgStrokeColor(args.vg, borderColor);
-    // nvgStrokeWidth(args.vg, mm2px(borderWidth));
-    // nvgLineCap(args.vg, NVG_ROUND);
-    // int iAbove = i - rowLength;
-    // if (iAbove < 0) {
-    //   iAbove += length;
-    // }
-    // int iBelow = i + rowLength;
-    // if (iBelow >= length) {
-    //   iBelow -= length;
-    // }
-    // if (!module->isInRange(iAbove) && i >= rowLength) {
-    //   nvgBeginPath(args.vg);
-    //   nvgMoveTo(args.vg, left, top);
-    //   nvgLineTo(args.vg, right, top);
-    //   nvgStroke(args.vg);
-    // }
-    // if (!module->isInRange(iBelow) && i < length - rowLength) {
-    //   nvgBeginPath(args.vg);
-    //   nvgMoveTo(args.vg, left, bottom);
-    //   nvgLineTo(args.vg, right, bottom);
-    //   nvgStroke(args.vg);
-    // }
-    // if (i == module->minIndex) {
-    //   nvgBeginPath(args.vg);
-    //   nvgMoveTo(args.vg, left, top);
-    //   nvgLineTo(args.vg, left, bottom);
-    //   nvgStroke(args.vg);
-    // }
-    // if (i == module->maxIndex) {
-    //   nvgBeginPath(args.vg);
-    //   nvgMoveTo(args.vg, right, top);
-    //   nvgLineTo(args.vg, right, bottom);
-    //   nvgStroke(args.vg);
-    // }
-
-    // Range caps
-    nvgStrokeColor(args.vg, capColor);
-    nvgStrokeWidth(args.vg, mm2px(capWidth));
-    nvgLineCap(args.vg, NVG_ROUND);
-    if (i == module->minIndex) {
-      nvgBeginPath(args.vg);
-      nvgMoveTo(args.vg, cx, top);
-      nvgArcTo(args.vg, left, top, left, bottom, capRadius);
-      nvgArcTo(args.vg, left, bottom, cx, bottom, capRadius);
-      nvgLineTo(args.vg, cx, bottom);
-      nvgStroke(args.vg);
+  OpaqueWidget::step();
+}
+
+void Grid::draw(const DrawArgs& args) {
+  OpaqueWidget::draw(args);
+
+  if (!module) {
+    return;
+  }
+
+  // Active dot
+  int i = module->index;
+  if (i >= 0 && i < length && module->isInRange(i)) {
+    math::Vec pos = getCellPosition(i, rowLength, itemWidth);
+    const float cx = mm2px(pos.x + itemWidth / 2.f);
+    const float cy = mm2px(pos.y + itemWidth / 2.f);
+
+    nvgBeginPath(args.vg);
+    nvgCircle(args.vg, cx, cy, itemWidth / 1.5f);
+    nvgFillColor(args.vg, dotColor);
+    nvgFill(args.vg);
+  }
+}
+
+namespace {
+  void GridCells::draw(const DrawArgs& args) {
+    EntropyBase* module = grid->module;
+    const int length = grid->length;
+    const int rowLength = grid->rowLength;
+    const int itemWidth = grid->itemWidth;
+
+    const float* values = module ? module->getDisplayValues() : grid->getPreviewValues();
+    const float minValue = module ? module->minValue.load() : 0.f;
+    const float maxValue = module ? module->maxValue.load() : 1.f;
+
+    // Cells are batched by color, with alpha quantized, so each color is one fill or stroke call
+    std::vector<int> batches(length);
+    bool isBatchUsed[NUM_BATCHES] = {};
+    for (int i = 0; i < length; i++) {
+      float value = values[i];
+      bool isFiltered = maxValue < value || value < minValue;
+      bool isInRange = module ? module->isInRange(i) : true;
+
+      int alpha = (int)std::round(clamp01(value) * (NUM_ALPHA_BUCKETS - 1));
+      batches[i] = ((isInRange ? 2 : 0) + (isFiltered ? 1 : 0)) * NUM_ALPHA_BUCKETS + alpha;
+      isBatchUsed[batches[i]] = true;
     }
-    if (i == module->maxIndex) {
+
+    for (int batch = 0; batch < NUM_BATCHES; batch++) {
+      if (!isBatchUsed[batch]) {
+        continue;
+      }
+
+      bool isInRange = batch / NUM_ALPHA_BUCKETS >= 2;
+      bool isFiltered = (batch / NUM_ALPHA_BUCKETS) % 2 == 1;
+      float alpha = (float)(batch % NUM_ALPHA_BUCKETS) / (NUM_ALPHA_BUCKETS - 1);
+
+      const NVGcolor color = isInRange
+        ? nvgRGBA(46, 160, 67, alpha * 255.f)
+        : nvgRGBA(96, 96, 96, alpha * 255.f);
+
       nvgBeginPath(args.vg);
-      nvgMoveTo(args.vg, cx, top);
-      nvgArcTo(args.vg, right, top, right, bottom, capRadius);
-      nvgArcTo(args.vg, right, bottom, cx, bottom, capRadius);
-      nvgLineTo(args.vg, cx, bottom);
-      nvgStroke(args.vg);
+      for (int i = 0; i < length; i++) {
+        if (batches[i] != batch) {
+          continue;
+        }
+
+        math::Vec pos = getCellPosition(i, rowLength, itemWidth);
+        const int x = pos.x;
+        const int y = pos.y;
+
+        if (isFiltered) {
+          nvgRoundedRect(args.vg, mm2px(x + .2f), mm2px(y + .2f), mm2px(itemWidth - .4f), mm2px(itemWidth - .4f), rectRadius);
+        } else {
+          nvgRoundedRect(args.vg, mm2px(x), mm2px(y), mm2px(itemWidth), mm2px(itemWidth), rectRadius);
+        }
+      }
+
+      if (isFiltered) {
+        nvgStrokeColor(args.vg, color);
+        nvgStrokeWidth(args.vg, mm2px(.4f));
+        nvgStroke(args.vg);
+      } else {
+        nvgFillColor(args.vg, color);
+        nvgFill(args.vg);
+      }
     }
 
-    // Active dot
-    if (i == module->index) {
-      nvgBeginPath(args.vg);
-      nvgCircle(args.vg, cx, cy, itemWidth / 1.5f);
-      nvgFillColor(args.vg, dotColor);
-      nvgFill(args.vg);
+    if (!module) {
+      return;
     }
+
+    for (int i = 0; i < length; i++) {
+      if (!module->isInRange(i)) {
+        continue;
+      }
+
+      math::Vec pos = getCellPosition(i, rowLength, itemWidth);
+      const int x = pos.x;
+      const int y = pos.y;
+
+      const float top = mm2px(y - borderWidth);
+      const float right = mm2px(x + itemWidth + borderWidth);
+      const float bottom = mm2px(y + itemWidth + borderWidth);
+      const float left = mm2px(x - borderWidth);
+      const float cx = mm2px(x + itemWidth / 2.f);
+
+      // Range blob
+      // Maybe nice as a toggle, as it looks cool in normal cases, but is noisy and just kind of weird
+      // to deal with edge cases - left/right borders at edges of grid look odd... but losing the caps
+      // sucks in some cases? Also, should round the corners - but in the appropriate directions!
+      // nvgStrokeColor(args.vg, borderColor);
+      // nvgStrokeWidth(args.vg, mm2px(borderWidth));
+      // nvgLineCap(args.vg, NVG_ROUND);
+      // int iAbove = i - rowLength;
+      // if (iAbove < 0) {
+      //   iAbove += length;
+      // }
+      // int iBelow = i + rowLength;
+      // if (iBelow >= length) {
+      //   iBelow -= length;
+      // }
+      // if (!module->isInRange(iAbove) && i >= rowLength) {
+      //   nvgBeginPath(args.vg);
+      //   nvgMoveTo(args.vg, left, top);
+      //   nvgLineTo(args.vg, right, top);
+      //   nvgStroke(args.vg);
+      // }
+      // if (!module->isInRange(iBelow) && i < length - rowLength) {
+      //   nvgBeginPath(args.vg);
+      //   nvgMoveTo(args.vg, left, bottom);
+      //   nvgLineTo(args.vg, right, bottom);
+      //   nvgStroke(args.vg);
+      // }
+      // if (i == module->minIndex) {
+      //   nvgBeginPath(args.vg);
+      //   nvgMoveTo(args.vg, left, top);
+      //   nvgLineTo(args.vg, left, bottom);
+      //   nvgStroke(args.vg);
+      // }
+      // if (i == module->maxIndex) {
+      //   nvgBeginPath(args.vg);
+      //   nvgMoveTo(args.vg, right, top);
+      //   nvgLineTo(args.vg, right, bottom);
+      //   nvgStroke(args.vg);
+      // }
+
+      // Range caps
+      nvgStrokeColor(args.vg, capColor);
+      nvgStrokeWidth(args.vg, mm2px(capWidth));
+      nvgLineCap(args.vg, NVG_ROUND);
+      if (i == module->minIndex) {
+        nvgBeginPath(args.vg);
+        nvgMoveTo(args.vg, cx, top);
+        nvgArcTo(args.vg, left, top, left, bottom, capRadius);
+        nvgArcTo(args.vg, left, bottom, cx, bottom, capRadius);
+        nvgLineTo(args.vg, cx, bottom);
+        nvgStroke(args.vg);
+      }
+      if (i == module->maxIndex) {
+        nvgBeginPath(args.vg);
+        nvgMoveTo(args.vg, cx, top);
+        nvgArcTo(args.vg, right, top, right, bottom, capRadius);
+        nvgArcTo(args.vg, right, bottom, cx, bottom, capRadius);
+        nvgLineTo(args.vg, cx, bottom);
+        nvgStroke(args.vg);
+      }
+    }
+  }
+}
+
+const float* Grid::getPreviewValues() {
+  if ((int)previewValues.size() != length) {
+    previewValues.resize(length);
+    EntropyBase::generateValues(EntropyBase::MERSENNE_TWISTER_ENGINE, EntropyBase::DEFAULT_SEED, previewValues.data(), 0, length);
   }
+
+  return previewValues.data();
 }
 
 void Grid::onEnter(const EnterEvent& event) {
@@ -150,8 +282,14 @@ void Grid::onHover(const HoverEvent& event) {
 }
 
 void Grid::onDragMove(const DragMoveEvent& event) {
+  // Endless values aren't stored, so can't be edited
+  if (hoverIndex < 0 || hoverIndex >= module->values.length || module->getEndless()) {
+    return;
+  }
+
   float delta = event.mouseDelta.y / 200.f;
-  module->values[hoverIndex] = clamp01(module->values[hoverIndex] - delta);
+  float value = module->values.read(ValuePool::UI_READER)[hoverIndex];
+  module->values.set(hoverIndex, clamp01(value - delta));
   updateTooltip();
 }
 
@@ -162,16 +300,23 @@ void Grid::onLeave(const LeaveEvent& event) {
 }
 
 void Grid::updateTooltip() {
-  if (hoverIndex >= 0 && (size_t)hoverIndex < module->values.size()) {
-    tooltip->text = string::f("Index %i: %.2f", hoverIndex, module->values[hoverIndex]);
+  uint32_t version = module->getValuesVersion();
+  if (hoverIndex == tooltipIndex && version == tooltipVersion) {
+    return;
+  }
+  tooltipIndex = hoverIndex;
+  tooltipVersion = version;
+
+  if (hoverIndex >= 0 && hoverIndex < module->values.length) {
+    tooltip->text = string::f("Index %i: %.2f", hoverIndex, module->getDisplayValues()[hoverIndex]);
   } else {
     tooltip->text = "";
   }
 }
 
 void Grid::onButton(const ButtonEvent& event) {
-  if (event.button == GLFW_MOUSE_BUTTON_RIGHT && event.action == GLFW_PRESS) {
-    GridValueEditor* editor = new GridValueEditor(hoverIndex, &module->values[hoverIndex]);
+  if (event.button == GLFW_MOUSE_BUTTON_RIGHT && event.action == GLFW_PRESS && !module->getEndless()) {
+    GridValueEditor* editor = new GridValueEditor(&module->values, hoverIndex);
     new Popup(editor, getAbsoluteOffset(event.pos));
     event.consume(this);
     return;
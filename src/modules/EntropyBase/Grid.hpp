@@ -4,11 +4,14 @@
 
 #include <rack.hpp>
 
-#include <random>
+#include <vector>
 
+// Cells are drawn into a framebuffer that is only redrawn when what they show changes, and the
+// playhead is drawn on top every frame
 struct Grid : rack::OpaqueWidget {
   Grid();
 
+  void step() override;
   void draw(const DrawArgs &args) override;
   void onEnter(const EnterEvent& event) override;
   void onHover(const HoverEvent& event) override;
@@ -19,15 +22,30 @@ struct Grid : rack::OpaqueWidget {
   rack::ui::Tooltip* tooltip;
   int length, rowLength, itemWidth;
 
-  // Will be null in previews - use default rng to generate a preview grid
+  // Will be null in previews
   EntropyBase* module = nullptr;
 
-  std::mt19937 defaultRng{42u};
-  std::uniform_real_distribution<float> defaultDistribution{0.f, 1.f};
+  // What a new module would start with, shown in previews - generated once
+  const float* getPreviewValues();
 
 private:
   void updateTooltip();
 
   int hoverIndex = 0;
+  // What the tooltip was last written for
+  int tooltipIndex = -1;
+  uint32_t tooltipVersion = 0;
+  std::vector<float> previewValues;
+
+  rack::widget::FramebufferWidget* framebuffer;
+
+  // Versions of what the framebuffer was last drawn from
+  struct DrawnState {
+    uint32_t valuesVersion;
+    uint32_t rangeVersion;
+    uint32_t filterVersion;
+
+    bool operator==(const DrawnState& other) const;
+  };
+  DrawnState drawnState = {};
 };
-
@@ -6,8 +6,9 @@ using namespace rack;
 
 namespace {
   struct GridValueEditorInput : ui::TextField {
-    float* pValue;
-    GridValueEditorInput(float* pValue) : pValue(pValue) {}
+    ValuePool* values;
+    int index;
+    GridValueEditorInput(ValuePool* values, int index) : values(values), index(index) {}
 
     bool wasFocused = false;
     void draw(const DrawArgs& args) override{
@@ -23,9 +24,9 @@ namespace {
     void onAction(const ActionEvent& e) override {
       ui::TextField::onAction(e);
 
-      if (pValue) {
+      if (values) {
         try {
-          *pValue = clamp01(std::stof(this->text));
+          values->set(index, clamp01(std::stof(this->text)));
         } catch (...) {}
       }
 
@@ -34,7 +35,7 @@ namespace {
   };
 }
 
-GridValueEditor::GridValueEditor(int index, float* pValue) {
+GridValueEditor::GridValueEditor(ValuePool* values, int index) {
   ui::MenuLabel* label = new ui::MenuLabel();
   label->text = string::f("Index %i value", index);
   addChild(label);
@@ -43,10 +44,10 @@ GridValueEditor::GridValueEditor(int index, float* pValue) {
   inputContainer->box.size = math::Vec(150.f, 25.f);
   addChild(inputContainer);
 
-  input = new GridValueEditorInput(pValue);
+  input = new GridValueEditorInput(values, index);
   input->box.size = inputContainer->box.size;
-  if (pValue) {
-    input->text = std::to_string(*pValue);
+  if (values && index >= 0 && index < values->length) {
+    input->text = std::to_string(values->read(ValuePool::UI_READER)[index]);
   }
   inputContainer->addChild(input);
 }
@@ -1,9 +1,11 @@
 #pragma once
 
+#include "ValuePool.hpp"
+
 #include <rack.hpp>
 
 struct GridValueEditor : rack::ui::Menu {
-  GridValueEditor(int index, float* pValue);
+  GridValueEditor(ValuePool* values, int index);
 
 private:
   rack::ui::TextField* input;
@@ -1,6 +1,8 @@
 #include "LengthParamQuantity.hpp"
+#include "../../helpers/clamp.hpp"
 
 std::string LengthParamQuantity::getString() {
+  int length = getLength();
   if (length >= 0) {
     return getLabel() + ": " + std::to_string(length);
   } else {
@@ -9,7 +11,14 @@ std::string LengthParamQuantity::getString() {
 }
 
 std::string LengthParamQuantity::getDisplayValueString() {
-  return std::to_string(length);
+  return std::to_string(getLength());
+}
+
+// Derived from the knob alone, matching EntropyBase::updateRange without CV - the range includes
+// both ends, so it covers one more step than the index offset
+int LengthParamQuantity::getLength() {
+  int length = (int)(clamp11(getValue()) * (totalLength - 0.5f));
+  return length < 0 ? length - 1 : length + 1;
 }
 
 void LengthParamQuantity::setDisplayValueString(std::string string) {
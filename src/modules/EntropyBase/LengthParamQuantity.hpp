@@ -7,5 +7,8 @@ struct LengthParamQuantity : rack::ParamQuantity {
   std::string getDisplayValueString() override;
   std::string getString() override;
 
-  int length, totalLength;
+  int totalLength;
+
+private:
+  int getLength();
 };
@@ -1,7 +1,9 @@
 #include "StartParamQuantity.hpp"
+#include "../../helpers/clamp.hpp"
 
+// Derived from the knob alone, matching EntropyBase::updateRange without CV
 float StartParamQuantity::getDisplayValue() {
-  return index;
+  return (int)(clamp01(getValue()) * (totalLength - 0.5f));
 }
 
 void StartParamQuantity::setDisplayValueString(std::string string) {
@@ -3,7 +3,7 @@
 #include <string>
 
 struct StartParamQuantity : rack::ParamQuantity {
-  int index, totalLength;
+  int totalLength;
 
   float getDisplayValue() override;
   void setDisplayValueString(std::string string) override;
@@ -0,0 +1,107 @@
+#include "ValuePool.hpp"
+
+ValuePool::ValuePool(int length, float* storage)
+  : length(length),
+    buffers(storage)
+{
+  std::fill(buffers, buffers + NUM_BUFFERS * length, 0.f);
+
+  for (auto& hazard : hazards) {
+    hazard.store(-1);
+  }
+}
+
+const float* ValuePool::read(Reader reader) {
+  // Announce the buffer before using it, and retry if it was replaced before writers could see
+  // the announcement - once this settles, writers will not recycle it until the next read
+  int buffer = current.load();
+  while (true) {
+    hazards[reader].store(buffer);
+
+    int latest = current.load();
+    if (latest == buffer) {
+      return getBuffer(buffer);
+    }
+    buffer = latest;
+  }
+}
+
+void ValuePool::set(int index, float value) {
+  if (index < 0 || index >= length) {
+    return;
+  }
+
+  write([=](float* values) {
+    values[index] = value;
+  });
+}
+
+void ValuePool::assign(const std::vector<float>& values) {
+  write([&](float* target) {
+    int count = std::min((int)values.size(), length);
+    std::copy(values.begin(), values.begin() + count, target);
+    std::fill(target + count, target + length, 0.f);
+  });
+}
+
+bool ValuePool::hasNext() {
+  return next.load() >= 0;
+}
+
+void ValuePool::discardNext() {
+  std::lock_guard<std::mutex> lock(writeMutex);
+  next.store(-1);
+}
+
+// Announces the buffer before taking it from next, so findSpareBuffer always sees it in next,
+// swapping, or current
+bool ValuePool::swapNext(uint32_t& tag) {
+  int buffer = next.load();
+  if (buffer < 0) {
+    return false;
+  }
+
+  swapping.store(buffer);
+  if (!next.compare_exchange_strong(buffer, -1)) {
+    // Discarded in the meantime
+    swapping.store(-1);
+    return false;
+  }
+
+  tag = tags[buffer];
+  current.store(buffer);
+  swapping.store(-1);
+  version++;
+  return true;
+}
+
+uint32_t ValuePool::getVersion() {
+  return version.load();
+}
+
+float* ValuePool::getBuffer(int buffer) {
+  return buffers + buffer * length;
+}
+
+// Only called with writeMutex held - swapNext can still move the next buffer to current, so next,
+// swapping, and current are loaded in the order that move goes through them, which means it
+// can't hide the buffer from all three
+int ValuePool::findSpareBuffer() {
+  int busyNext = next.load();
+  int busySwapping = swapping.load();
+  int busy = current.load();
+  for (int buffer = 0; buffer < NUM_BUFFERS; buffer++) {
+    bool isBusy = buffer == busy || buffer == busyNext || buffer == busySwapping;
+    for (auto& hazard : hazards) {
+      isBusy = isBusy || hazard.load() == buffer;
+    }
+
+    if (!isBusy) {
+      return buffer;
+    }
+  }
+
+  // Unreachable, as there is always one more buffer than current, next, a swap, and every
+  // reader's
+  return (busy + 1) % NUM_BUFFERS;
+}
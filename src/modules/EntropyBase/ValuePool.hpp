@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Pool values shared between the audio thread, the UI thread, and background threads
+// Writers fill a spare buffer and publish it with a single atomic store, and readers pick up the
+// current buffer with an atomic load. Buffers are allocated once and recycled by writers when no
+// reader can still be looking at them, so reads never lock or allocate.
+// A buffer can also be filled ahead of time and swapped in later, which is just as cheap.
+struct ValuePool {
+  enum Reader {
+    AUDIO_READER,
+    UI_READER,
+    NUM_READERS
+  };
+
+  // Each reader can hold on to a buffer other than the current and next ones, and so can a swap
+  // in progress, plus one spare
+  static constexpr int NUM_BUFFERS = NUM_READERS + 4;
+
+  // Backing memory for a pool, so it can live inline in whatever owns the pool
+  template <int LENGTH>
+  using Storage = std::array<float, NUM_BUFFERS * LENGTH>;
+
+  ValuePool(int length, float* storage);
+
+  // The returned values stay valid until the same reader reads again
+  const float* read(Reader reader);
+
+  // Copies the current values into a spare buffer, lets fill modify them, then publishes them
+  template <typename F>
+  void write(F fill) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+
+    // swapNext can replace the current buffer at any time, in which case start over from that
+    int source = current.load();
+    while (true) {
+      int target = findSpareBuffer();
+      std::copy(getBuffer(source), getBuffer(source) + length, getBuffer(target));
+      fill(getBuffer(target));
+
+      if (current.compare_exchange_strong(source, target)) {
+        version++;
+        return;
+      }
+    }
+  }
+
+  // Lets fill populate a spare buffer to be published later by swapNext, unless one is waiting
+  // The tag stays with the buffer, and comes back from swapNext - like the seed of its values
+  template <typename F>
+  void prepareNext(uint32_t tag, F fill) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+
+    if (next.load() >= 0) {
+      return;
+    }
+
+    int target = findSpareBuffer();
+    fill(getBuffer(target));
+    tags[target] = tag;
+    next.store(target);
+  }
+
+  bool hasNext();
+  void discardNext();
+
+  // Changes whenever different values are published
+  uint32_t getVersion();
+  // Publishes the prepared buffer and returns its tag, if there is one, without locking - safe to
+  // call from the audio thread, which is the only caller
+  bool swapNext(uint32_t& tag);
+
+  void set(int index, float value);
+  // Copies as many values as fit, zero filling the rest
+  void assign(const std::vector<float>& values);
+
+  const int length;
+
+private:
+  float* buffers;
+  std::atomic<int> current{0};
+  std::atomic<int> next{-1};
+  std::atomic<uint32_t> version{0};
+  std::atomic<int> hazards[NUM_READERS];
+  // The buffer swapNext is moving from next to current
+  std::atomic<int> swapping{-1};
+  // Written before a buffer becomes next, and read while it can't be recycled
+  uint32_t tags[NUM_BUFFERS] = {};
+  std::mutex writeMutex;
+
+  float* getBuffer(int buffer);
+  int findSpareBuffer();
+};
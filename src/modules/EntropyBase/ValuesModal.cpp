@@ -38,7 +38,8 @@ ValuesModal::ValuesModal(EntropyBase* module)
   valuesField = new ui::TextField();
   valuesField->box.pos = Vec(14, 28);
   valuesField->box.size = Vec(253, 38);
-  valuesField->text = join(module->values);
+  const float* values = module->values.read(ValuePool::UI_READER);
+  valuesField->text = join(std::vector<float>(values, values + module->totalLength));
   addChild(TextFieldContainer::wrap(valuesField));
 
   statusLabel = new ui::Label();
@@ -70,7 +71,7 @@ bool ValuesModal::onSave() {
       values.push_back(value);
     }
 
-    module->values = values;
+    module->values.assign(values);
     return true;
   } catch(...) {
     statusLabel->text = "Error";
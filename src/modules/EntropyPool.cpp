@@ -8,11 +8,7 @@ static constexpr int ENTROPY_POOL_LENGTH = 240;
 static constexpr int ENTROPY_POOL_ROW_LENGTH = 24;
 static constexpr int ENTROPY_POOL_GRID_ITEM_WIDTH = 5;
 
-struct EntropyPool : EntropyBase {
-  EntropyPool()
-    : EntropyBase(ENTROPY_POOL_LENGTH)
-  {}
-};
+struct EntropyPool : EntropyModule<ENTROPY_POOL_LENGTH> {};
 
 struct EntropyPoolWidget : EntropyBaseWidget {
   EntropyPoolWidget(EntropyPool* module) : EntropyBaseWidget(module, "res/EntropyPool3.svg") {
@@ -63,6 +59,7 @@ struct EntropyPoolWidget : EntropyBaseWidget {
     addInput(createInputCentered<DarkPJ301MPort>(mm2px(Vec(x + d * 0, y)), module, EntropyPool::START_INPUT));
     addInput(createInputCentered<DarkPJ301MPort>(mm2px(Vec(x + d * 1, y)), module, EntropyPool::FILTER_INPUT));
     addInput(createInputCentered<DarkPJ301MPort>(mm2px(Vec(x + d * 2, y)), module, EntropyPool::LENGTH_INPUT));
+    addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(x + d * 3, y)), module, EntropyPool::DENSITY_OUTPUT));
 
     x = 111.74;
     addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(x + d * 0, y)), module, EntropyPool::EOS_OUTPUT));
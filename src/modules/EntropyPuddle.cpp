@@ -8,11 +8,7 @@ static constexpr int ENTROPY_PUDDLE_LENGTH = 96;
 static constexpr int ENTROPY_PUDDLE_ROW_LENGTH = 12;
 static constexpr int ENTROPY_PUDDLE_GRID_ITEM_WIDTH = 5;
 
-struct EntropyPuddle : EntropyBase {
-  EntropyPuddle()
-    : EntropyBase(ENTROPY_PUDDLE_LENGTH)
-  {}
-};
+struct EntropyPuddle : EntropyModule<ENTROPY_PUDDLE_LENGTH> {};
 
 struct EntropyPuddleWidget : EntropyBaseWidget {
   EntropyPuddleWidget(EntropyPuddle* module) : EntropyBaseWidget(module, "res/EntropyPuddle3.svg") {
@@ -61,6 +57,7 @@ struct EntropyPuddleWidget : EntropyBaseWidget {
     addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(x + d * 2, y)), module, EntropyPuddle::GATE_OUTPUT));
     addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(x + d * 3, y)), module, EntropyPuddle::CV_OUTPUT));
     addParam(createParamCentered<Trimpot>(mm2px(Vec(x + d * 4, y)), module, EntropyPuddle::SCALE_PARAM));
+    addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(x + d * 5, y)), module, EntropyPuddle::DENSITY_OUTPUT));
   }
 };
 
@@ -0,0 +1,181 @@
+// Times EntropyBase::process for both module sizes at common sample rates, under a steady patch and
+// a busy one, reporting the cost per sample, the 99th percentile block time, and how often the
+// audio thread allocates - compare runs between builds to catch regressions
+
+#include "hooks.hpp"
+#include "../src/modules/EntropyBase/EntropyBase.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace rack;
+
+namespace {
+  // Rack's default block size
+  const int BLOCK_SIZE = 256;
+  // Blocks run before timing starts, while tables are first built
+  const int WARMUP_BLOCKS = 32;
+
+  struct Load {
+    const char* name;
+    float clockHz;
+    float cvHz;
+    float randomizeHz;
+    bool isSkipFiltered;
+  };
+
+  const Load loads[] = {
+    // Sequencing at tempo, with slowly moving CV
+    {"steady", 8.f, .1f, .5f, false},
+    // Clocked near audio rate, with fast CV and skipping, which rebuilds the most
+    {"busy", 2000.f, 50.f, 20.f, true}
+  };
+
+  struct Result {
+    double nsPerSample;
+    double p99BlockUs;
+    double budgetUs;
+    double allocationsPerSecond;
+  };
+
+  // Inputs for one block, generated ahead so only process is timed
+  struct Block {
+    static const int NUM_CV = 3;
+
+    float clocks[BLOCK_SIZE][EntropyBase::MAX_CHANNELS];
+    float cvs[BLOCK_SIZE][NUM_CV][EntropyBase::MAX_CHANNELS];
+    float randoms[BLOCK_SIZE];
+
+    void generate(const Load& load, float sampleRate, int64_t frame, int channels) {
+      for (int i = 0; i < BLOCK_SIZE; i++) {
+        double t = (frame + i) / sampleRate;
+        for (int c = 0; c < channels; c++) {
+          // Channels are spread in phase, so they clock and sweep at different times
+          double offset = (double)c / channels;
+          clocks[i][c] = std::fmod(t * load.clockHz + offset, 1.) < .5 ? 10.f : 0.f;
+          for (int cv = 0; cv < NUM_CV; cv++) {
+            double phase = std::fmod(t * load.cvHz * (cv + 1) + offset, 1.);
+            cvs[i][cv][c] = (float)(std::fabs(phase * 2. - 1.) * 10. - 5.);
+          }
+        }
+        randoms[i] = std::fmod(t * load.randomizeHz, 1.) < .5 ? 10.f : 0.f;
+      }
+    }
+  };
+
+  template <int LENGTH>
+  Result run(const Load& load, float sampleRate, int channels, double seconds) {
+    EntropyModule<LENGTH> module;
+    Module& m = module;
+    m.onAdd(Module::AddEvent());
+    module.setSkipFiltered(load.isSkipFiltered);
+
+    m.params[EntropyBase::RUN_PARAM].setValue(1.f);
+    m.params[EntropyBase::START_PARAM].setValue(.1f);
+    m.params[EntropyBase::LENGTH_PARAM].setValue(.5f);
+    m.params[EntropyBase::FILTER_PARAM].setValue(.2f);
+    for (int id : {EntropyBase::START_CV_PARAM, EntropyBase::LENGTH_CV_PARAM, EntropyBase::FILTER_CV_PARAM}) {
+      m.params[id].setValue(.3f);
+    }
+
+    const int cvInputs[Block::NUM_CV] = {EntropyBase::START_INPUT, EntropyBase::LENGTH_INPUT, EntropyBase::FILTER_INPUT};
+    m.inputs[EntropyBase::CLOCK_INPUT].connect(channels);
+    m.inputs[EntropyBase::RANDOM_INPUT].connect();
+    for (int id : cvInputs) {
+      m.inputs[id].connect(channels);
+    }
+    // As most patches use it, without the density output
+    for (int id : {EntropyBase::EOS_OUTPUT, EntropyBase::TRIGGER_OUTPUT, EntropyBase::GATE_OUTPUT, EntropyBase::CV_OUTPUT}) {
+      m.outputs[id].connect();
+    }
+
+    const int numBlocks = std::max(1, (int)(seconds * sampleRate / BLOCK_SIZE));
+    std::vector<double> blockNs;
+    blockNs.reserve(numBlocks);
+    Block* block = new Block();
+    double totalNs = 0;
+    long allocations = 0;
+
+    Module::ProcessArgs args = {sampleRate, 1.f / sampleRate, 0};
+    for (int b = 0; b < WARMUP_BLOCKS + numBlocks; b++) {
+      // The UI thread's share, untimed
+      module.prepareRandomValues();
+      JobPool::get().runCompletions();
+      block->generate(load, sampleRate, args.frame, channels);
+
+      hooks::watch(true);
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < BLOCK_SIZE; i++, args.frame++) {
+        for (int c = 0; c < channels; c++) {
+          m.inputs[EntropyBase::CLOCK_INPUT].setVoltage(block->clocks[i][c], c);
+          for (int cv = 0; cv < Block::NUM_CV; cv++) {
+            m.inputs[cvInputs[cv]].setVoltage(block->cvs[i][cv][c], c);
+          }
+        }
+        m.inputs[EntropyBase::RANDOM_INPUT].setVoltage(block->randoms[i]);
+
+        m.process(args);
+      }
+      auto end = std::chrono::steady_clock::now();
+      hooks::watch(false);
+
+      long blockAllocations = hooks::takeAllocations();
+      if (b < WARMUP_BLOCKS) {
+        continue;
+      }
+      double ns = std::chrono::duration<double, std::nano>(end - start).count();
+      blockNs.push_back(ns);
+      totalNs += ns;
+      allocations += blockAllocations;
+    }
+    delete block;
+    hooks::takeAll();
+
+    std::sort(blockNs.begin(), blockNs.end());
+    Result result;
+    result.nsPerSample = totalNs / ((double)numBlocks * BLOCK_SIZE);
+    result.p99BlockUs = blockNs[std::min(numBlocks - 1, (int)std::ceil(numBlocks * .99) - 1)] / 1000.;
+    result.budgetUs = BLOCK_SIZE / sampleRate * 1e6;
+    result.allocationsPerSecond = allocations / ((double)numBlocks * BLOCK_SIZE / sampleRate);
+    return result;
+  }
+
+  void print(const char* module, float sampleRate, int channels, const Load& load, Result result) {
+    std::printf(
+      "%-8s %8.1f %9d  %-7s %10.1f %10.2f %9.2f%% %10.1f\n",
+      module,
+      sampleRate / 1000.f,
+      channels,
+      load.name,
+      result.nsPerSample,
+      result.p99BlockUs,
+      result.p99BlockUs / result.budgetUs * 100.,
+      result.allocationsPerSecond
+    );
+  }
+}
+
+// Takes how many seconds of audio to run each case for, one by default
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? std::atof(argv[1]) : 1.;
+  if (!hooks::check()) {
+    return 1;
+  }
+
+  std::printf("Blocks of %d samples, %g s of audio per case\n\n", BLOCK_SIZE, seconds);
+  std::printf(
+    "%-8s %8s %9s  %-7s %10s %10s %10s %10s\n",
+    "module", "kHz", "channels", "load", "ns/sample", "p99 us", "of block", "allocs/s"
+  );
+  for (const Load& load : loads)
+  for (int channels : {1, 16})
+  for (float sampleRate : {44100.f, 48000.f, 96000.f, 192000.f}) {
+    print("pool", sampleRate, channels, load, run<240>(load, sampleRate, channels, seconds));
+    print("puddle", sampleRate, channels, load, run<96>(load, sampleRate, channels, seconds));
+  }
+  return 0;
+}
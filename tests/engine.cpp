@@ -0,0 +1,298 @@
+// Checks what EntropyBase keeps up to date incrementally against recomputations from scratch, while
+// process runs through random filter moves, value edits and pool swaps
+
+#include "../src/modules/EntropyBase/EntropyBase.hpp"
+#include "../src/helpers/fenwick.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace rack;
+
+// A friend of EntropyBase, so it can read what process works out
+struct EntropyBaseTest {
+  // What differs between channel c's skip tables and ones built from scratch, if anything
+  static std::string checkPassingIndices(EntropyBase& module, int c) {
+    int n = module.totalLength;
+    int g = c / 4;
+    float minValue = module.minValues[g][c % 4];
+    float maxValue = module.maxValues[g][c % 4];
+
+    if (module.passingChanges[c] != module.passChanges[c]) {
+      return "out of date";
+    }
+
+    std::vector<int> passing;
+    for (int index = 0; index < n; index++) {
+      float value = module.audioValues[index];
+      if (minValue <= value && value <= maxValue) {
+        passing.push_back(index);
+      }
+    }
+
+    for (int index = 0; index < n; index++) {
+      int next = -1;
+      int previous = -1;
+      if (!passing.empty()) {
+        auto after = std::lower_bound(passing.begin(), passing.end(), index);
+        next = after == passing.end() ? passing.front() : *after;
+        auto before = std::upper_bound(passing.begin(), passing.end(), index);
+        previous = before == passing.begin() ? passing.back() : *(before - 1);
+      }
+
+      int tableNext = module.nextPassing[c * n + index];
+      int tablePrevious = module.previousPassing[c * n + index];
+      if (tableNext != next || tablePrevious != previous) {
+        return string::f(
+          "at %d, next %d and previous %d, not %d and %d",
+          index, tableNext, tablePrevious, next, previous
+        );
+      }
+    }
+    return "";
+  }
+
+  // What differs between channel c's active step tree and density output, and counts from scratch,
+  // if anything
+  static std::string checkActiveSteps(EntropyBase& module, int c) {
+    int n = module.totalLength;
+    int g = c / 4;
+    int i = c % 4;
+    float minValue = module.minValues[g][i];
+    float maxValue = module.maxValues[g][i];
+    const int* counts = module.activeCounts + c * n;
+
+    if (
+      module.activeVersions[c] != module.audioValuesVersion ||
+      module.activeMinValues[c] != minValue ||
+      module.activeMaxValues[c] != maxValue
+    ) {
+      return "out of date";
+    }
+
+    for (int index = 0; index < n; index++) {
+      float value = module.audioValues[index];
+      int isPassing = minValue <= value && value <= maxValue;
+      int treeCount = fenwickSum(counts, index + 1) - fenwickSum(counts, index);
+      if (treeCount != isPassing) {
+        return string::f("at %d, the tree has %d, not %d", index, treeCount, isPassing);
+      }
+    }
+
+    int minIndex = (int)module.minIndices[g][i];
+    int maxIndex = (int)module.maxIndices[g][i];
+    int count = countPassing(module.audioValues, n, minIndex, maxIndex, minValue, maxValue);
+    float density = (float)count / ((maxIndex - minIndex + n) % n + 1);
+    float voltage = module.outputs[EntropyBase::DENSITY_OUTPUT].getVoltage(c);
+    if (std::fabs(voltage - density * 10.f) > 1e-4f) {
+      return string::f("density output %f, not %f (%d active steps)", voltage, density * 10.f, count);
+    }
+    return "";
+  }
+
+  // What differs between the tooltip's count for channel 0 and one from scratch, if anything
+  static std::string checkTooltipCount(EntropyBase& module) {
+    int n = module.totalLength;
+    float minValue = module.minValues[0][0];
+    float maxValue = module.maxValues[0][0];
+    int minIndex = (int)module.minIndices[0][0];
+    int maxIndex = (int)module.maxIndices[0][0];
+    const float* values = module.values.read(ValuePool::UI_READER);
+    int count = countPassing(values, n, minIndex, maxIndex, minValue, maxValue);
+    float density = (float)count / ((maxIndex - minIndex + n) % n + 1);
+
+    int tooltipCount;
+    float tooltipDensity;
+    module.countActiveSteps(tooltipCount, tooltipDensity);
+    if (tooltipCount != count || std::fabs(tooltipDensity - density) > 1e-6f) {
+      return string::f("%d active steps (%f), not %d (%f)", tooltipCount, tooltipDensity, count, density);
+    }
+    return "";
+  }
+
+  // Walks the range one index at a time, wrapping past the end of the pool
+  static int countPassing(const float* values, int n, int minIndex, int maxIndex, float minValue, float maxValue) {
+    int count = 0;
+    for (int index = minIndex; ; index = (index + 1) % n) {
+      count += minValue <= values[index] && values[index] <= maxValue;
+      if (index == maxIndex) {
+        return count;
+      }
+    }
+  }
+};
+
+namespace {
+  const int CHANNELS = EntropyBase::MAX_CHANNELS;
+  const int SAMPLES = 3000;
+
+  // Fixed, so failures can be reproduced
+  std::mt19937 rng(1);
+
+  float uniform(float min, float max) {
+    return std::uniform_real_distribution<float>(min, max)(rng);
+  }
+
+  bool chance(float p) {
+    return uniform(0.f, 1.f) < p;
+  }
+
+  int failures = 0;
+
+  void check(bool isPassing, const std::string& what) {
+    if (!isPassing) {
+      // Enough to go on, without flooding the output
+      if (failures < 20) {
+        std::printf("FAIL: %s\n", what.c_str());
+      }
+      failures++;
+    }
+  }
+
+  // Sorted pools are the worst case for patching, as each index a filter move toggles is next to
+  // the last
+  enum PoolKind {
+    RANDOM_POOL,
+    RAMP_POOL
+  };
+
+  const char* describe(PoolKind kind) {
+    return kind == RAMP_POOL ? "ramp" : "random";
+  }
+
+  // Runs process on every channel with filter CV that mostly drifts, but now and then jumps, or
+  // lands the filter exactly on a value, calling after with the sample after each process - ranges
+  // move now and then too, wrapping and reversing, and random pools are edited and swapped
+  template <int LENGTH, typename F>
+  void drive(EntropyModule<LENGTH>& module, PoolKind kind, F after) {
+    Module& m = module;
+    m.onAdd(Module::AddEvent());
+    module.setControlRate(1);
+    if (kind == RAMP_POOL) {
+      std::vector<float> ramp(LENGTH);
+      for (int i = 0; i < LENGTH; i++) {
+        ramp[i] = (float)i / (LENGTH - 1);
+      }
+      module.values.assign(ramp);
+    }
+
+    m.params[EntropyBase::RUN_PARAM].setValue(1.f);
+    m.params[EntropyBase::LENGTH_PARAM].setValue(.4f);
+    m.params[EntropyBase::FILTER_CV_PARAM].setValue(1.f);
+    m.params[EntropyBase::START_CV_PARAM].setValue(1.f);
+    m.params[EntropyBase::LENGTH_CV_PARAM].setValue(1.f);
+    m.inputs[EntropyBase::CLOCK_INPUT].connect(CHANNELS);
+    m.inputs[EntropyBase::FILTER_INPUT].connect(CHANNELS);
+    m.inputs[EntropyBase::START_INPUT].connect(CHANNELS);
+    m.inputs[EntropyBase::LENGTH_INPUT].connect(CHANNELS);
+    m.inputs[EntropyBase::RANDOM_INPUT].connect();
+
+    Module::ProcessArgs args = {48000.f, 1.f / 48000.f, 0};
+    for (int sample = 0; sample < SAMPLES; sample++, args.frame++) {
+      // The UI thread's share
+      if (sample % 64 == 0) {
+        module.prepareRandomValues();
+        JobPool::get().runCompletions();
+      }
+      if (kind == RANDOM_POOL && chance(.005f)) {
+        module.values.set((int)uniform(0.f, LENGTH - 1), uniform(0.f, 1.f));
+      }
+      bool isSwapping = kind == RANDOM_POOL && chance(.002f);
+      m.inputs[EntropyBase::RANDOM_INPUT].setVoltage(isSwapping ? 10.f : 0.f);
+
+      if (chance(.01f)) {
+        // On a value, so the filter's bound is exactly equal to it
+        m.params[EntropyBase::FILTER_PARAM].setValue(module.values.read(ValuePool::UI_READER)[(int)uniform(0.f, LENGTH - 1)]);
+        for (int c = 0; c < CHANNELS; c++) {
+          m.inputs[EntropyBase::FILTER_INPUT].setVoltage(0.f, c);
+        }
+      } else {
+        for (int c = 0; c < CHANNELS; c++) {
+          float voltage = m.inputs[EntropyBase::FILTER_INPUT].getVoltage(c);
+          voltage = chance(.02f) ? uniform(-10.f, 10.f) : clamp(voltage + uniform(-.05f, .05f), -10.f, 10.f);
+          m.inputs[EntropyBase::FILTER_INPUT].setVoltage(voltage, c);
+        }
+      }
+
+      for (int c = 0; c < CHANNELS; c++) {
+        m.inputs[EntropyBase::CLOCK_INPUT].setVoltage((sample / (2 + c)) % 2 ? 10.f : 0.f, c);
+        if (chance(.005f)) {
+          m.inputs[EntropyBase::START_INPUT].setVoltage(uniform(0.f, 10.f), c);
+          m.inputs[EntropyBase::LENGTH_INPUT].setVoltage(uniform(-10.f, 10.f), c);
+        }
+      }
+
+      m.process(args);
+      after(sample);
+    }
+  }
+
+  // Skip tables are patched as filters move, and rebuilt when values change
+  template <int LENGTH>
+  void testPassingIndices(PoolKind kind) {
+    EntropyModule<LENGTH> module;
+    module.setSkipFiltered(true);
+    drive(module, kind, [&](int sample) {
+      for (int c = 0; c < CHANNELS; c++) {
+        std::string error = EntropyBaseTest::checkPassingIndices(module, c);
+        check(error.empty(), string::f("skip tables, %d %s pool, sample %d, channel %d: %s", LENGTH, describe(kind), sample, c, error.c_str()));
+      }
+    });
+  }
+
+  // Active steps are counted for the density output, or for skipping, picking up after any time
+  // they weren't from where they were left - the tooltip counts for itself either way
+  template <int LENGTH>
+  void testActiveSteps(PoolKind kind, bool isSkipFiltered) {
+    EntropyModule<LENGTH> module;
+    Output& densityOutput = module.outputs[EntropyBase::DENSITY_OUTPUT];
+    module.setSkipFiltered(isSkipFiltered);
+    densityOutput.connect();
+    drive(module, kind, [&](int sample) {
+      std::string description = string::f("%d %s pool%s, sample %d", LENGTH, describe(kind), isSkipFiltered ? ", skipping" : "", sample);
+
+      if (densityOutput.isConnected()) {
+        check(densityOutput.getChannels() == CHANNELS, "density output: " + description + ": wrong number of channels");
+      }
+      if (densityOutput.isConnected() || isSkipFiltered) {
+        for (int c = 0; c < CHANNELS; c++) {
+          std::string error = EntropyBaseTest::checkActiveSteps(module, c);
+          check(error.empty(), string::f("active steps, %s, channel %d: %s", description.c_str(), c, error.c_str()));
+        }
+      }
+
+      std::string error = EntropyBaseTest::checkTooltipCount(module);
+      check(error.empty(), string::f("tooltip, %s: %s", description.c_str(), error.c_str()));
+
+      // Unplugged for a while now and then, so counting has to catch up
+      if (sample % 500 == 250) {
+        densityOutput.disconnect();
+      } else if (sample % 500 == 400) {
+        densityOutput.connect();
+      }
+    });
+  }
+}
+
+int main() {
+  for (PoolKind kind : {RANDOM_POOL, RAMP_POOL}) {
+    testPassingIndices<240>(kind);
+    testPassingIndices<96>(kind);
+
+    for (bool isSkipFiltered : {false, true}) {
+      testActiveSteps<240>(kind, isSkipFiltered);
+      testActiveSteps<96>(kind, isSkipFiltered);
+    }
+  }
+
+  if (failures > 0) {
+    std::printf("%d failures\n", failures);
+    return 1;
+  }
+  std::printf("ok: skip tables, active step counts and density outputs match\n");
+  return 0;
+}
@@ -0,0 +1,276 @@
+// Runs GitHubIntegration against the stand-in server - first each way a request can go, recorded,
+// failing or cached, then waves of concurrent fetches mixing slow, truncated, dropped and 5xx
+// replies, reporting throughput and latency per kind of reply
+
+#include "server.hpp"
+#include "../../src/modules/EntropyBase/GitHubIntegration.hpp"
+
+#include <rack.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace rack;
+
+Plugin* pluginInstance;
+
+namespace {
+  using Clock = std::chrono::steady_clock;
+
+  const std::string TOKEN = "test-token";
+  const char* USER_DIR = "build/github-user";
+  // Long enough to stand out from the rest, short enough to keep the run quick
+  const int SLOW_MS = 300;
+  // Leaves room in the job pool's queue for the plugin's own jobs
+  const int WAVE_SIZE = 32;
+  const int NUM_WAVES = 4;
+
+  // Both within a year, then needing two
+  const int ONE_YEAR = 300;
+  const int TWO_YEARS = 500;
+
+  int failures = 0;
+
+  void check(bool isPassing, const std::string& what) {
+    if (!isPassing) {
+      std::printf("FAIL: %s\n", what.c_str());
+      failures++;
+    }
+  }
+
+  double getSeconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  // Runs completions, as the UI thread would, until every fetch has called back or the deadline
+  bool wait(const int& pending, double timeout) {
+    Clock::time_point start = Clock::now();
+    while (pending > 0 && getSeconds(start) < timeout) {
+      JobPool::get().runCompletions();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return pending == 0;
+  }
+
+  GitHubIntegration::Result fetch(const std::string& nameAndToken, int length) {
+    GitHubIntegration::Result result{false, "Timed out", {}};
+    int pending = 1;
+    GitHubIntegration::fetchNormalizedContributions(nameAndToken, length, true, JobPool::createToken(), [&](GitHubIntegration::Result r) {
+      result = r;
+      pending--;
+    });
+    wait(pending, 60);
+    return result;
+  }
+
+  // Checks one fetch's outcome, and how many requests it took
+  void expect(StandInServer& server, const std::string& what, const std::string& nameAndToken, int length, const std::string& error, int requests) {
+    int before = server.requests;
+    GitHubIntegration::Result result = fetch(nameAndToken, length);
+    if (error.empty()) {
+      check(result.success, what + ": failed with " + result.error);
+      check(result.values.size() == (size_t)length, what + ": " + std::to_string(result.values.size()) + " values");
+    } else {
+      check(!result.success && result.error == error, what + ": got '" + result.error + "', not '" + error + "'");
+    }
+    int made = server.requests - before;
+    check(made == requests, what + ": " + std::to_string(made) + " requests, not " + std::to_string(requests));
+  }
+
+  // Past the cache's TTL, so the next fetch asks again
+  void ageCache() {
+    rack::testing::unixTimeOffset += GitHubCache::TTL + 60 * 60;
+  }
+
+  void testOutcomes(StandInServer& server) {
+    expect(server, "recorded", "a@" + TOKEN, ONE_YEAR, "", 1);
+    expect(server, "cached", "a@" + TOKEN, ONE_YEAR, "", 0);
+    expect(server, "viewer", TOKEN, ONE_YEAR, "", 1);
+    expect(server, "no token", "a@", ONE_YEAR, "Token is required", 0);
+    expect(server, "wrong token", "a@wrong", ONE_YEAR, "Bad token (401)", 1);
+
+    // Both workers saving the same entry at once, which must leave it whole
+    int pending = 2;
+    for (int f = 0; f < 2; f++) {
+      GitHubIntegration::fetchNormalizedContributions("slow-c@" + TOKEN, ONE_YEAR, true, JobPool::createToken(), [&](GitHubIntegration::Result result) {
+        check(result.success, "saved together: failed with " + result.error);
+        pending--;
+      });
+    }
+    check(wait(pending, 60), "saved together: timed out");
+    expect(server, "saved together, then cached", "slow-c@" + TOKEN, ONE_YEAR, "", 0);
+
+    expect(server, "two years", "b@" + TOKEN, TWO_YEARS, "", 1);
+    check(server.lastYears == 2, "two years: asked for " + std::to_string(server.lastYears) + " years");
+    expect(server, "shorter than cached", "b@" + TOKEN, ONE_YEAR, "", 0);
+
+    ageCache();
+    int notModified = server.notModified;
+    expect(server, "revalidated", "a@" + TOKEN, ONE_YEAR, "", 1);
+    check(server.notModified == notModified + 1, "revalidated: no 304");
+    expect(server, "cached after revalidating", "a@" + TOKEN, ONE_YEAR, "", 0);
+
+    // Stale data is served when GitHub fails, whichever way it does
+    for (StandInServer::Mode mode : {StandInServer::ERROR_500, StandInServer::ERROR_502, StandInServer::ERROR_503, StandInServer::DROPPED}) {
+      ageCache();
+      server.mode = mode;
+      expect(server, std::string("stale, then ") + StandInServer::MODE_NAMES[mode], "a@" + TOKEN, ONE_YEAR, "", 1);
+    }
+
+    // Only a year is cached, which offline is all there is for two, so the steps after it are 0
+    ageCache();
+    GitHubIntegration::Result result = fetch("a@" + TOKEN, TWO_YEARS);
+    check(result.success && result.values.size() == (size_t)TWO_YEARS, "short history: failed with " + result.error);
+    if (result.success) {
+      bool isPaddedAfter = std::all_of(result.values.begin() + 365, result.values.end(), [](float value) {
+        return value == 0.f;
+      });
+      bool hasHistory = std::any_of(result.values.begin() + 365 - 7, result.values.begin() + 365, [](float value) {
+        return value > 0.f;
+      });
+      check(isPaddedAfter && hasHistory, "short history: not padded after the most recent day");
+    }
+    server.mode = StandInServer::OK;
+
+    expect(server, "500", "500-a@" + TOKEN, ONE_YEAR, "API error (500)", 1);
+    expect(server, "502", "502-a@" + TOKEN, ONE_YEAR, "API error (502)", 1);
+    expect(server, "503", "503-a@" + TOKEN, ONE_YEAR, "API error (503)", 1);
+    expect(server, "truncated", "truncated-a@" + TOKEN, ONE_YEAR, "Parsing error", 1);
+    expect(server, "dropped", "dropped-a@" + TOKEN, ONE_YEAR, "Failed", 1);
+    expect(server, "not found", "ghost@" + TOKEN, ONE_YEAR, "Parsing error", 1);
+
+    Clock::time_point start = Clock::now();
+    expect(server, "slow", "slow-a@" + TOKEN, ONE_YEAR, "", 1);
+    double seconds = getSeconds(start);
+    check(seconds >= SLOW_MS / 1000., "slow: took " + std::to_string(seconds) + " s");
+
+    // Still requested, but never called back
+    pending = 1;
+    std::shared_ptr<JobPool::Token> token = JobPool::createToken();
+    GitHubIntegration::fetchNormalizedContributions("slow-b@" + TOKEN, ONE_YEAR, true, token, [&](GitHubIntegration::Result) {
+      pending--;
+    });
+    token->cancel();
+    check(!wait(pending, SLOW_MS * 3 / 1000.), "cancelled: called back");
+  }
+
+  struct Latencies {
+    std::vector<double> seconds;
+    int failures = 0;
+  };
+
+  void print(const char* name, Latencies& latencies, double seconds) {
+    std::vector<double>& s = latencies.seconds;
+    std::sort(s.begin(), s.end());
+    size_t n = s.size();
+    std::printf(
+      "%-10s %8zu %10.1f %10.1f %10.1f %9d\n",
+      name,
+      n,
+      n / seconds,
+      s[n / 2] * 1000.,
+      s[std::min(n - 1, (size_t)std::ceil(n * .99) - 1)] * 1000.,
+      latencies.failures
+    );
+  }
+
+  // Waves of concurrent fetches, each a new user so nothing is cached, then the same users again,
+  // all from the cache
+  void testLoad(StandInServer& server) {
+    const StandInServer::Mode modes[] = {
+      StandInServer::OK, StandInServer::SLOW, StandInServer::TRUNCATED, StandInServer::DROPPED, StandInServer::ERROR_502
+    };
+    const std::map<StandInServer::Mode, std::string> errors = {
+      {StandInServer::OK, ""},
+      {StandInServer::SLOW, ""},
+      {StandInServer::TRUNCATED, "Parsing error"},
+      {StandInServer::DROPPED, "Failed"},
+      {StandInServer::ERROR_502, "API error (502)"}
+    };
+
+    std::map<StandInServer::Mode, Latencies> byMode;
+    Latencies all, cached;
+    double loadSeconds = 0, cachedSeconds = 0;
+
+    for (bool isCached : {false, true}) {
+      for (int wave = 0; wave < NUM_WAVES; wave++) {
+        int pending = 0;
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < WAVE_SIZE; i++) {
+          StandInServer::Mode mode = modes[i % 5];
+          // Only successful fetches are cached, so those are all that's repeated
+          if (isCached && !errors.at(mode).empty()) {
+            continue;
+          }
+          std::string username = std::string(StandInServer::MODE_NAMES[mode]) + "-load-" + std::to_string(wave * WAVE_SIZE + i);
+          Clock::time_point submitted = Clock::now();
+          pending++;
+          GitHubIntegration::fetchNormalizedContributions(username + "@" + TOKEN, ONE_YEAR, true, JobPool::createToken(), [&, mode, submitted](GitHubIntegration::Result result) {
+            double seconds = getSeconds(submitted);
+            const std::string& error = errors.at(mode);
+            bool isExpected = error.empty() ? result.success : (!result.success && result.error == error);
+            Latencies& latencies = isCached ? cached : byMode[mode];
+            latencies.seconds.push_back(seconds);
+            if (!isExpected) {
+              latencies.failures++;
+              check(false, std::string("load: ") + StandInServer::MODE_NAMES[mode] + " got '" + result.error + "'");
+            }
+            if (!isCached) {
+              all.seconds.push_back(seconds);
+              all.failures += !isExpected;
+            }
+            pending--;
+          });
+        }
+        check(wait(pending, 120), "load: timed out");
+        (isCached ? cachedSeconds : loadSeconds) += getSeconds(start);
+      }
+    }
+
+    std::printf("\n%d waves of %d concurrent fetches, %d workers\n\n", NUM_WAVES, WAVE_SIZE, 2);
+    std::printf("%-10s %8s %10s %10s %10s %9s\n", "reply", "fetches", "fetches/s", "p50 ms", "p99 ms", "failures");
+    for (StandInServer::Mode mode : modes) {
+      print(StandInServer::MODE_NAMES[mode], byMode[mode], loadSeconds);
+    }
+    print("all", all, loadSeconds);
+    print("cached", cached, cachedSeconds);
+  }
+}
+
+int main(int argc, char** argv) {
+  pluginInstance = new Plugin();
+  pluginInstance->slug = "sporkbomb";
+
+  // Starts from an empty cache
+  std::filesystem::remove_all(USER_DIR);
+  setenv("RACK_USER_DIR", USER_DIR, 1);
+
+  StandInServer server(argc > 1 ? argv[1] : "github/fixtures", TOKEN);
+  server.slowMs = SLOW_MS;
+  int port = server.start("127.0.0.1", 0);
+  if (port < 0) {
+    std::printf("FAIL: can't start the stand-in server\n");
+    return 1;
+  }
+  // Read once, on the first fetch
+  setenv("SPORKBOMB_GITHUB_ENDPOINT", ("http://127.0.0.1:" + std::to_string(port) + "/graphql").c_str(), 1);
+
+  testOutcomes(server);
+  testLoad(server);
+  server.stop();
+
+  if (failures > 0) {
+    std::printf("\n%d failures\n", failures);
+    return 1;
+  }
+  std::printf("\nok: %d requests\n", (int)server.requests);
+  return 0;
+}
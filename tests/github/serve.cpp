@@ -0,0 +1,52 @@
+// Serves the recorded responses on their own, to run Rack against -
+//   make github-server GITHUB_SERVER_ARGS="--port 8080 --mode slow"
+// then start Rack with SPORKBOMB_GITHUB_ENDPOINT=http://127.0.0.1:8080/graphql, and use the token
+// it prints
+
+#include "server.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+int main(int argc, char** argv) {
+  std::string fixtures = "github/fixtures";
+  std::string host = "127.0.0.1";
+  std::string token = "test-token";
+  int port = 8080;
+  StandInServer::Mode mode = StandInServer::OK;
+  int slowMs = 1500;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string arg = argv[i];
+    std::string value = argv[i + 1];
+    if (arg == "--fixtures") {
+      fixtures = value;
+    } else if (arg == "--host") {
+      host = value;
+    } else if (arg == "--port") {
+      port = std::atoi(value.c_str());
+    } else if (arg == "--token") {
+      token = value;
+    } else if (arg == "--slow-ms") {
+      slowMs = std::atoi(value.c_str());
+    } else if (arg != "--mode" || !StandInServer::parseMode(value, mode)) {
+      std::fprintf(stderr, "Unknown option %s %s\n", arg.c_str(), value.c_str());
+      return 1;
+    }
+  }
+
+  StandInServer server(fixtures, token);
+  server.mode = mode;
+  server.slowMs = slowMs;
+
+  std::printf("Serving %s on http://%s:%d/graphql for token %s\n", StandInServer::MODE_NAMES[mode], host.c_str(), port, token.c_str());
+  std::printf("Usernames starting with a mode, like slow-1 or 503-1, get that mode, and ghost doesn't exist\n");
+  std::fflush(stdout);
+  if (!server.listen(host, port)) {
+    std::fprintf(stderr, "Can't listen on %s:%d\n", host.c_str(), port);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,182 @@
+// As in GitHubIntegration.cpp, which it's linked with - httplib's classes differ without it
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+
+#include "server.hpp"
+
+#include <httplib/httplib.h>
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+  std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("Can't read " + path);
+    }
+    std::stringstream s;
+    s << file.rdbuf();
+    return s.str();
+  }
+
+  // Weak, like GitHub's
+  std::string getETag(const std::string& body) {
+    char s[32];
+    std::snprintf(s, sizeof(s), "W/\"%016zx\"", std::hash<std::string>()(body));
+    return s;
+  }
+
+  // A username names a mode if it starts with one, then a dash
+  bool getUsernameMode(const std::string& username, StandInServer::Mode& mode) {
+    size_t dash = username.find('-');
+    return dash != std::string::npos && StandInServer::parseMode(username.substr(0, dash), mode);
+  }
+}
+
+const char* StandInServer::MODE_NAMES[NUM_MODES] = {
+  "ok", "slow", "truncated", "dropped", "500", "502", "503"
+};
+
+bool StandInServer::parseMode(const std::string& name, Mode& mode) {
+  for (int m = 0; m < NUM_MODES; m++) {
+    if (name == MODE_NAMES[m]) {
+      mode = (Mode)m;
+      return true;
+    }
+  }
+  return false;
+}
+
+StandInServer::StandInServer(const std::string& fixturesPath, const std::string& token)
+  : token(token),
+    server(new httplib::Server())
+{
+  // Kept as text, so replies are the recording byte for byte
+  nlohmann::json recording = nlohmann::json::parse(readFile(fixturesPath + "/contributions.json"));
+  const nlohmann::json& years = recording["data"]["user"];
+  for (int y = (int)years.size() - 1; y >= 0; --y) {
+    calendars.push_back(years.at("year" + std::to_string(y)).dump());
+  }
+
+  notFoundBody = readFile(fixturesPath + "/not-found.json");
+  badCredentialsBody = readFile(fixturesPath + "/bad-credentials.json");
+
+  route();
+}
+
+StandInServer::~StandInServer() {
+  stop();
+}
+
+void StandInServer::route() {
+  server->Post(".*", [this](const httplib::Request& req, httplib::Response& res) {
+    requests++;
+
+    if (req.get_header_value("Authorization") != "Bearer " + token) {
+      res.status = 401;
+      res.set_content(badCredentialsBody, "application/json");
+      return;
+    }
+
+    nlohmann::json request = nlohmann::json::parse(req.body, nullptr, false);
+    if (!request.is_object() || !request["query"].is_string()) {
+      res.status = 400;
+      return;
+    }
+    std::string query = request["query"];
+    std::string username = request.value(nlohmann::json::json_pointer("/variables/username"), std::string());
+
+    Mode mode = this->mode;
+    getUsernameMode(username, mode);
+    if (mode == ERROR_500 || mode == ERROR_502 || mode == ERROR_503) {
+      res.status = std::stoi(MODE_NAMES[mode]);
+      return;
+    }
+
+    if (username == "ghost") {
+      res.set_content(notFoundBody, "application/json");
+      return;
+    }
+
+    // Each aliased collection gets a recorded calendar, in the order the query asks for them, with
+    // the most recent year last in the recording
+    std::string scope = username.empty() ? "viewer" : "user";
+    std::string body = "{\"data\":{\"" + scope + "\":{";
+    std::regex alias("(year(\\d+)): contributionsCollection");
+    int years = 0;
+    for (std::sregex_iterator it(query.begin(), query.end(), alias), end; it != end; ++it, ++years) {
+      int year = std::stoi((*it)[2]);
+      const std::string& calendar = calendars[calendars.size() - 1 - year % calendars.size()];
+      body += (years ? ",\"" : "\"") + (*it)[1].str() + "\":" + calendar;
+    }
+    body += "}}}";
+    lastYears = years;
+
+    std::string etag = getETag(body);
+    if (mode == OK && req.get_header_value("If-None-Match") == etag) {
+      res.status = 304;
+      notModified++;
+      return;
+    }
+    res.set_header("ETag", etag);
+
+    if (mode == TRUNCATED) {
+      body.resize(body.size() / 2);
+    }
+
+    if (mode == SLOW || mode == DROPPED) {
+      auto shared = std::make_shared<std::string>(body);
+      int chunks = mode == SLOW ? 10 : 2;
+      int delayMs = mode == SLOW ? slowMs / chunks : 0;
+      size_t chunkSize = (shared->size() + chunks - 1) / chunks;
+      res.set_content_provider(shared->size(), "application/json",
+        [=](size_t offset, size_t length, httplib::DataSink& sink) {
+          // Dropped replies stop halfway, which closes the connection
+          if (mode == DROPPED && offset >= shared->size() / 2) {
+            return false;
+          }
+          std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+          sink.write(shared->data() + offset, std::min(chunkSize, length));
+          return true;
+        }
+      );
+      return;
+    }
+
+    res.set_content(body, "application/json");
+  });
+}
+
+int StandInServer::start(const std::string& host, int port) {
+  if (port == 0) {
+    port = server->bind_to_any_port(host);
+  } else if (!server->bind_to_port(host, port)) {
+    port = -1;
+  }
+  if (port < 0) {
+    return -1;
+  }
+
+  thread = std::thread([this] {
+    server->listen_after_bind();
+  });
+  server->wait_until_ready();
+  return port;
+}
+
+bool StandInServer::listen(const std::string& host, int port) {
+  return server->listen(host, port);
+}
+
+void StandInServer::stop() {
+  server->stop();
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace httplib {
+  class Server;
+}
+
+// Stands in for GitHub's GraphQL endpoint, replaying the recorded responses in fixtures/, along
+// with the failures the integration has to get through - point SPORKBOMB_GITHUB_ENDPOINT at it
+struct StandInServer {
+  enum Mode {
+    // The recorded response, with an ETag, and 304 for requests that already have it
+    OK,
+    // The recorded response, trickled out over slowMs
+    SLOW,
+    // Half the recorded response, as a complete reply
+    TRUNCATED,
+    // Half the recorded response, then the connection closes
+    DROPPED,
+    ERROR_500,
+    ERROR_502,
+    ERROR_503,
+    NUM_MODES
+  };
+  static const char* MODE_NAMES[NUM_MODES];
+  static bool parseMode(const std::string& name, Mode& mode);
+
+  // Requests must carry this as their bearer token, or get GitHub's 401
+  StandInServer(const std::string& fixturesPath, const std::string& token);
+  ~StandInServer();
+
+  // Serves on a background thread, on any free port if port is 0 - returns the port, or -1
+  int start(const std::string& host, int port);
+  // Serves until stopped from another thread
+  bool listen(const std::string& host, int port);
+  void stop();
+
+  // For requests whose username doesn't start with a mode's name, like slow-1 or 503-1
+  std::atomic<Mode> mode{OK};
+  std::atomic<int> slowMs{1500};
+
+  // Requests answered, how many of them were 304s, and how many years of history the last one
+  // asked for
+  std::atomic<int> requests{0};
+  std::atomic<int> notModified{0};
+  std::atomic<int> lastYears{0};
+
+private:
+  void route();
+
+  std::string token;
+  // Recorded calendars, oldest first, reused in turn for requests wanting more years
+  std::vector<std::string> calendars;
+  std::string notFoundBody;
+  std::string badCredentialsBody;
+
+  std::unique_ptr<httplib::Server> server;
+  std::thread thread;
+};
@@ -0,0 +1,292 @@
+#include "hooks.hpp"
+
+#include <rack.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <random>
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <time.h>
+
+using namespace rack;
+
+namespace {
+  enum Hook {
+    MALLOC,
+    CALLOC,
+    REALLOC,
+    FREE,
+    MEMALIGN,
+    NEW,
+    DELETE,
+    MUTEX_LOCK,
+    MUTEX_TRYLOCK,
+    COND_WAIT,
+    COND_SIGNAL,
+    READ,
+    WRITE,
+    OPEN,
+    CLOSE,
+    GETRANDOM,
+    NANOSLEEP,
+    SCHED_YIELD,
+    SYSCALL,
+    NUM_HOOKS
+  };
+
+  const char* hookNames[NUM_HOOKS] = {
+    "malloc", "calloc", "realloc", "free", "memalign", "operator new", "operator delete",
+    "pthread_mutex_lock", "pthread_mutex_trylock", "pthread_cond_wait", "pthread_cond_signal",
+    "read", "write", "open", "close", "getrandom", "nanosleep", "sched_yield", "syscall"
+  };
+
+  thread_local bool isThreadWatched = false;
+  std::atomic<long> hookCounts[NUM_HOOKS];
+
+  inline void hit(Hook hook) {
+    if (isThreadWatched) {
+      hookCounts[hook]++;
+    }
+  }
+
+  // Looked up on first use - dlsym can allocate, but never while watched, as check calls
+  // everything first
+  template <typename F>
+  F real(F& f, const char* name) {
+    if (!f) {
+      f = (F)dlsym(RTLD_NEXT, name);
+    }
+    return f;
+  }
+}
+
+extern "C" {
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t count, size_t size);
+  void* __libc_realloc(void* p, size_t size);
+  void* __libc_memalign(size_t alignment, size_t size);
+  void __libc_free(void* p);
+
+  void* malloc(size_t size) {
+    hit(MALLOC);
+    return __libc_malloc(size);
+  }
+
+  void* calloc(size_t count, size_t size) {
+    hit(CALLOC);
+    return __libc_calloc(count, size);
+  }
+
+  void* realloc(void* p, size_t size) {
+    hit(REALLOC);
+    return __libc_realloc(p, size);
+  }
+
+  void free(void* p) {
+    if (p) {
+      hit(FREE);
+    }
+    __libc_free(p);
+  }
+
+  void* memalign(size_t alignment, size_t size) {
+    hit(MEMALIGN);
+    return __libc_memalign(alignment, size);
+  }
+
+  void* aligned_alloc(size_t alignment, size_t size) {
+    hit(MEMALIGN);
+    return __libc_memalign(alignment, size);
+  }
+
+  int posix_memalign(void** p, size_t alignment, size_t size) {
+    hit(MEMALIGN);
+    *p = __libc_memalign(alignment, size);
+    return *p ? 0 : ENOMEM;
+  }
+
+  int pthread_mutex_lock(pthread_mutex_t* mutex) {
+    static int (*f)(pthread_mutex_t*);
+    hit(MUTEX_LOCK);
+    return real(f, "pthread_mutex_lock")(mutex);
+  }
+
+  int pthread_mutex_trylock(pthread_mutex_t* mutex) {
+    static int (*f)(pthread_mutex_t*);
+    hit(MUTEX_TRYLOCK);
+    return real(f, "pthread_mutex_trylock")(mutex);
+  }
+
+  int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex) {
+    static int (*f)(pthread_cond_t*, pthread_mutex_t*);
+    hit(COND_WAIT);
+    return real(f, "pthread_cond_wait")(cond, mutex);
+  }
+
+  int pthread_cond_signal(pthread_cond_t* cond) {
+    static int (*f)(pthread_cond_t*);
+    hit(COND_SIGNAL);
+    return real(f, "pthread_cond_signal")(cond);
+  }
+
+  int pthread_cond_broadcast(pthread_cond_t* cond) {
+    static int (*f)(pthread_cond_t*);
+    hit(COND_SIGNAL);
+    return real(f, "pthread_cond_broadcast")(cond);
+  }
+
+  ssize_t read(int fd, void* buffer, size_t count) {
+    static ssize_t (*f)(int, void*, size_t);
+    hit(READ);
+    return real(f, "read")(fd, buffer, count);
+  }
+
+  ssize_t write(int fd, const void* buffer, size_t count) {
+    static ssize_t (*f)(int, const void*, size_t);
+    hit(WRITE);
+    return real(f, "write")(fd, buffer, count);
+  }
+
+  int open(const char* path, int flags, ...) {
+    static int (*f)(const char*, int, ...);
+    va_list args;
+    va_start(args, flags);
+    int mode = va_arg(args, int);
+    va_end(args);
+    hit(OPEN);
+    return real(f, "open")(path, flags, mode);
+  }
+
+  int close(int fd) {
+    static int (*f)(int);
+    hit(CLOSE);
+    return real(f, "close")(fd);
+  }
+
+  ssize_t getrandom(void* buffer, size_t length, unsigned int flags) {
+    static ssize_t (*f)(void*, size_t, unsigned int);
+    hit(GETRANDOM);
+    return real(f, "getrandom")(buffer, length, flags);
+  }
+
+  int nanosleep(const struct timespec* duration, struct timespec* remaining) {
+    static int (*f)(const struct timespec*, struct timespec*);
+    hit(NANOSLEEP);
+    return real(f, "nanosleep")(duration, remaining);
+  }
+
+  int sched_yield() {
+    static int (*f)();
+    hit(SCHED_YIELD);
+    return real(f, "sched_yield")();
+  }
+
+  // Futex waits and wakes for atomics go through here
+  long syscall(long number, ...) {
+    static long (*f)(long, ...);
+    va_list args;
+    va_start(args, number);
+    long a[6];
+    for (long& arg : a) {
+      arg = va_arg(args, long);
+    }
+    va_end(args);
+    hit(SYSCALL);
+    return real(f, "syscall")(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+  }
+}
+
+void* operator new(size_t size) {
+  hit(NEW);
+  void* p = __libc_malloc(size);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+  if (p) {
+    hit(DELETE);
+  }
+  __libc_free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  operator delete(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+  operator delete(p);
+}
+
+namespace hooks {
+  void watch(bool isWatched) {
+    isThreadWatched = isWatched;
+  }
+
+  long takeAllocations() {
+    long count = 0;
+    for (Hook hook : {MALLOC, CALLOC, REALLOC, FREE, MEMALIGN, NEW, DELETE}) {
+      count += hookCounts[hook].exchange(0);
+    }
+    return count;
+  }
+
+  std::string takeAll() {
+    std::string hits;
+    for (int hook = 0; hook < NUM_HOOKS; hook++) {
+      long count = hookCounts[hook].exchange(0);
+      if (count) {
+        hits += string::f("%s%s x%ld", hits.empty() ? "" : ", ", hookNames[hook], count);
+      }
+    }
+    return hits;
+  }
+
+  bool check() {
+    std::mutex mutex;
+    // Where the default would use a CPU instruction, and make no call at all
+    std::random_device rd("/dev/urandom");
+    watch(true);
+    void* volatile p = std::malloc(16);
+    std::free(p);
+    delete new volatile int(0);
+    mutex.lock();
+    mutex.unlock();
+    volatile unsigned int r = rd();
+    (void)r;
+    watch(false);
+
+    bool isOk = true;
+    for (Hook hook : {MALLOC, FREE, NEW, DELETE, MUTEX_LOCK}) {
+      if (!hookCounts[hook]) {
+        std::printf("FAIL: %s isn't being intercepted\n", hookNames[hook]);
+        isOk = false;
+      }
+    }
+    // Depending on the libstdc++, random_device reads through one of these
+    if (!hookCounts[GETRANDOM] && !hookCounts[READ] && !hookCounts[SYSCALL]) {
+      std::printf("FAIL: random_device isn't being intercepted\n");
+      isOk = false;
+    }
+    takeAll();
+    return isOk;
+  }
+}
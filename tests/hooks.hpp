@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+
+// Interposes the allocator, locks, and the system call wrappers, counting the calls made from
+// watched threads - the tests watch the thread standing in for the audio thread while it is in
+// process
+namespace hooks {
+  void watch(bool isWatched);
+
+  // Allocations and frees counted since they were last taken
+  long takeAllocations();
+  // Everything counted since it was last taken, e.g. "malloc x2, read x1", or empty if nothing was
+  std::string takeAll();
+
+  // A gate that can't see anything passes everything, so tests first check each kind of hook
+  // fires, which prints any that don't
+  bool check();
+}
@@ -0,0 +1,167 @@
+// Saves pools with dataToJson and loads them into new modules with dataFromJson, as reopening a
+// patch does, checking every format loads back exactly - including patches saved before values
+// were encoded, and ones too damaged to load, which must fall back to the seed rather than throw
+
+#include "../src/modules/EntropyBase/EntropyBase.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace rack;
+
+namespace {
+  int failures = 0;
+
+  void check(bool isPassing, const std::string& what) {
+    if (!isPassing) {
+      std::printf("FAIL: %s\n", what.c_str());
+      failures++;
+    }
+  }
+
+  std::vector<float> getValues(EntropyBase& module) {
+    const float* values = module.values.read(ValuePool::UI_READER);
+    return std::vector<float>(values, values + module.totalLength);
+  }
+
+  std::vector<float> generateValues(EntropyBase::Engine engine, uint32_t seed, int length) {
+    std::vector<float> values(length);
+    EntropyBase::generateValues(engine, seed, values.data(), 0, length);
+    return values;
+  }
+
+  // Bit for bit, so negative zeros and denormals count
+  bool isSame(const std::vector<float>& a, const std::vector<float>& b) {
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+  }
+
+  // As Rack opens a patch - loaded between construction and being added
+  template <int LENGTH>
+  bool load(EntropyModule<LENGTH>& module, json_t* root) {
+    Module& m = module;
+    try {
+      m.dataFromJson(root);
+    } catch (...) {
+      return false;
+    }
+    m.onAdd(Module::AddEvent());
+    return true;
+  }
+
+  // Saves a pool with some values edited, the first to the given one, and loads it into a new
+  // module, checking it comes back with its seed, engine and values, saved in the format expected
+  template <int LENGTH>
+  void testRoundTrip(const std::string& name, EntropyBase::Engine engine, int edits, float firstEdit, const char* expectedKey) {
+    std::string description = string::f("%s, %d steps", name.c_str(), LENGTH);
+
+    EntropyModule<LENGTH> saved;
+    Module& m = saved;
+    saved.seed = 1234u;
+    saved.setEngine(engine);
+    m.onAdd(Module::AddEvent());
+    // Edited to values the seed can't generate
+    for (int e = 0; e < edits; e++) {
+      saved.values.set(e * LENGTH / edits, e == 0 ? firstEdit : e + .25f);
+    }
+
+    json_t* root = m.dataToJson();
+    check(json_object_get(root, expectedKey) != nullptr, description + ": not saved as " + expectedKey);
+    if (json_t* overridesJson = json_object_get(root, "overrides")) {
+      check((int)json_array_size(overridesJson) == edits, description + ": " + std::to_string(json_array_size(overridesJson)) + " overrides");
+    }
+
+    EntropyModule<LENGTH> loaded;
+    check(load(loaded, root), description + ": threw");
+    check(isSame(getValues(loaded), getValues(saved)), description + ": different values");
+    check(loaded.seed == saved.seed, description + ": different seed");
+    check(loaded.getEngine() == saved.getEngine(), description + ": different engine");
+    json_decref(root);
+  }
+
+  // Patches from before values were encoded have a JSON number per value, and a seed and index
+  template <int LENGTH>
+  void testLegacyArray() {
+    std::string description = string::f("legacy array, %d steps", LENGTH);
+    std::vector<float> values = generateValues(EntropyBase::MERSENNE_TWISTER_ENGINE, 77u, LENGTH);
+    values[3] = .5f;
+
+    json_t* root = json_object();
+    json_t* valuesJson = json_array();
+    for (float value : values) {
+      json_array_append_new(valuesJson, json_real(value));
+    }
+    json_object_set_new(root, "values", valuesJson);
+    json_object_set_new(root, "seed", json_integer(77));
+    json_object_set_new(root, "index", json_integer(LENGTH / 2));
+
+    EntropyModule<LENGTH> loaded;
+    check(load(loaded, root), description + ": threw");
+    check(isSame(getValues(loaded), values), description + ": different values");
+    check(loaded.seed == 77u, description + ": different seed");
+    check(loaded.index == LENGTH / 2, description + ": different index");
+    check(loaded.getEngine() == EntropyBase::MERSENNE_TWISTER_ENGINE, description + ": different engine");
+    json_decref(root);
+  }
+
+  // Encoded values that can't be decoded are ignored, so the pool is generated from the seed
+  template <int LENGTH>
+  void testMalformedValues(EntropyBase::Engine engine) {
+    std::string description = string::f("malformed base64, %s engine, %d steps", engine == EntropyBase::COUNTER_ENGINE ? "counter" : "Mersenne Twister", LENGTH);
+
+    json_t* root = json_object();
+    json_object_set_new(root, "values", json_string("not*base64!"));
+    json_object_set_new(root, "valuesEncoding", json_string("base64-f32le"));
+    json_object_set_new(root, "seed", json_integer(99));
+    json_object_set_new(root, "engine", json_integer(engine));
+
+    EntropyModule<LENGTH> loaded;
+    check(load(loaded, root), description + ": threw");
+    check(isSame(getValues(loaded), generateValues(engine, 99u, LENGTH)), description + ": not generated from the seed");
+    json_decref(root);
+  }
+
+  template <int LENGTH>
+  void testAll() {
+    const float denormal = 1e-40f;
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float infinity = std::numeric_limits<float>::infinity();
+
+    // Mersenne Twister pools are always saved in full, as other standard libraries could generate
+    // different values from the seed - bit for bit, so even values JSON numbers can't hold load back
+    testRoundTrip<LENGTH>("Mersenne Twister", EntropyBase::MERSENNE_TWISTER_ENGINE, 0, 0.f, "values");
+    testRoundTrip<LENGTH>("Mersenne Twister, edited", EntropyBase::MERSENNE_TWISTER_ENGINE, 5, .5f, "values");
+    testRoundTrip<LENGTH>("Mersenne Twister, denormal edit", EntropyBase::MERSENNE_TWISTER_ENGINE, 1, denormal, "values");
+    testRoundTrip<LENGTH>("Mersenne Twister, NaN edit", EntropyBase::MERSENNE_TWISTER_ENGINE, 1, nan, "values");
+
+    // Counter pools are saved as overrides of what the seed generates, up to a quarter of the pool
+    testRoundTrip<LENGTH>("counter, unedited", EntropyBase::COUNTER_ENGINE, 0, 0.f, "overrides");
+    testRoundTrip<LENGTH>("counter, one edit", EntropyBase::COUNTER_ENGINE, 1, .5f, "overrides");
+    testRoundTrip<LENGTH>("counter, -0 edit", EntropyBase::COUNTER_ENGINE, 1, -0.f, "overrides");
+    testRoundTrip<LENGTH>("counter, a quarter edited", EntropyBase::COUNTER_ENGINE, LENGTH / 4, .5f, "overrides");
+    testRoundTrip<LENGTH>("counter, over a quarter edited", EntropyBase::COUNTER_ENGINE, LENGTH / 4 + 1, .5f, "values");
+    testRoundTrip<LENGTH>("counter, all edited", EntropyBase::COUNTER_ENGINE, LENGTH, .5f, "values");
+    // Unless an override couldn't be saved exactly as a JSON number
+    testRoundTrip<LENGTH>("counter, denormal edit", EntropyBase::COUNTER_ENGINE, 1, denormal, "values");
+    testRoundTrip<LENGTH>("counter, NaN edit", EntropyBase::COUNTER_ENGINE, 1, nan, "values");
+    testRoundTrip<LENGTH>("counter, infinite edit", EntropyBase::COUNTER_ENGINE, 1, infinity, "values");
+
+    testLegacyArray<LENGTH>();
+    testMalformedValues<LENGTH>(EntropyBase::MERSENNE_TWISTER_ENGINE);
+    testMalformedValues<LENGTH>(EntropyBase::COUNTER_ENGINE);
+  }
+}
+
+int main() {
+  testAll<240>();
+  testAll<96>();
+
+  if (failures > 0) {
+    std::printf("%d failures\n", failures);
+    return 1;
+  }
+  std::printf("ok: every format loads back as saved\n");
+  return 0;
+}
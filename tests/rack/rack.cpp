@@ -0,0 +1,240 @@
+#include <rack.hpp>
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <map>
+#include <stdexcept>
+
+using namespace rack;
+
+struct json_t {
+  enum Type { OBJECT, ARRAY, STRING, REAL, INTEGER, BOOLEAN };
+
+  Type type;
+  int refs = 1;
+  double number = 0;
+  std::string string;
+  std::vector<json_t*> array;
+  std::map<std::string, json_t*> object;
+
+  json_t(Type type) : type(type) {}
+};
+
+namespace {
+  json_t* create(json_t::Type type, double number = 0) {
+    json_t* json = new json_t(type);
+    json->number = number;
+    return json;
+  }
+}
+
+json_t* json_object() { return create(json_t::OBJECT); }
+json_t* json_array() { return create(json_t::ARRAY); }
+json_t* json_real(double value) { return create(json_t::REAL, value); }
+json_t* json_integer(long long value) { return create(json_t::INTEGER, value); }
+json_t* json_boolean(int value) { return create(json_t::BOOLEAN, value ? 1 : 0); }
+json_t* json_true() { return json_boolean(1); }
+json_t* json_false() { return json_boolean(0); }
+
+json_t* json_string(const char* value) {
+  json_t* json = create(json_t::STRING);
+  json->string = value;
+  return json;
+}
+
+json_t* json_incref(json_t* json) {
+  if (json) {
+    json->refs++;
+  }
+  return json;
+}
+
+void json_decref(json_t* json) {
+  if (!json || --json->refs > 0) {
+    return;
+  }
+  for (json_t* value : json->array) {
+    json_decref(value);
+  }
+  for (auto& entry : json->object) {
+    json_decref(entry.second);
+  }
+  delete json;
+}
+
+int json_object_set_new(json_t* object, const char* key, json_t* value) {
+  json_t*& slot = object->object[key];
+  json_decref(slot);
+  slot = value;
+  return 0;
+}
+
+int json_object_set(json_t* object, const char* key, json_t* value) {
+  return json_object_set_new(object, key, json_incref(value));
+}
+
+int json_object_update(json_t* object, json_t* other) {
+  for (auto& entry : other->object) {
+    json_object_set(object, entry.first.c_str(), entry.second);
+  }
+  return 0;
+}
+
+json_t* json_object_get(const json_t* object, const char* key) {
+  if (!json_is_object(object)) {
+    return nullptr;
+  }
+  auto it = object->object.find(key);
+  return it == object->object.end() ? nullptr : it->second;
+}
+
+int json_array_append_new(json_t* array, json_t* value) {
+  array->array.push_back(value);
+  return 0;
+}
+
+int json_array_append(json_t* array, json_t* value) {
+  return json_array_append_new(array, json_incref(value));
+}
+
+size_t json_array_size(const json_t* array) {
+  return json_is_array(array) ? array->array.size() : 0;
+}
+
+json_t* json_array_get(const json_t* array, size_t index) {
+  return index < json_array_size(array) ? array->array[index] : nullptr;
+}
+
+bool json_is_array(const json_t* json) { return json && json->type == json_t::ARRAY; }
+bool json_is_object(const json_t* json) { return json && json->type == json_t::OBJECT; }
+bool json_is_integer(const json_t* json) { return json && json->type == json_t::INTEGER; }
+bool json_is_number(const json_t* json) { return json && (json->type == json_t::REAL || json_is_integer(json)); }
+bool json_is_string(const json_t* json) { return json && json->type == json_t::STRING; }
+bool json_is_boolean(const json_t* json) { return json && json->type == json_t::BOOLEAN; }
+bool json_is_true(const json_t* json) { return json_is_boolean(json) && json->number != 0; }
+double json_number_value(const json_t* json) { return json_is_number(json) ? json->number : 0; }
+long long json_integer_value(const json_t* json) { return json_is_integer(json) ? (long long)json->number : 0; }
+const char* json_string_value(const json_t* json) { return json_is_string(json) ? json->string.c_str() : nullptr; }
+
+namespace rack {
+  namespace string {
+    std::string f(const char* format, ...) {
+      va_list args;
+      va_start(args, format);
+      int size = vsnprintf(nullptr, 0, format, args);
+      va_end(args);
+
+      std::string s(size, '\0');
+      va_start(args, format);
+      vsnprintf(&s[0], size + 1, format, args);
+      va_end(args);
+      return s;
+    }
+
+    namespace {
+      const char* base64Chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    }
+
+    std::string toBase64(const uint8_t* data, size_t dataLen) {
+      std::string s;
+      for (size_t i = 0; i < dataLen; i += 3) {
+        uint32_t bits = data[i] << 16;
+        bits |= i + 1 < dataLen ? data[i + 1] << 8 : 0;
+        bits |= i + 2 < dataLen ? data[i + 2] : 0;
+        s += base64Chars[bits >> 18 & 63];
+        s += base64Chars[bits >> 12 & 63];
+        s += i + 1 < dataLen ? base64Chars[bits >> 6 & 63] : '=';
+        s += i + 2 < dataLen ? base64Chars[bits & 63] : '=';
+      }
+      return s;
+    }
+
+    std::string toBase64(const std::vector<uint8_t>& data) {
+      return toBase64(data.data(), data.size());
+    }
+
+    // Throws on invalid characters, as Rack's does
+    std::vector<uint8_t> fromBase64(const std::string& str) {
+      std::vector<uint8_t> data;
+      uint32_t bits = 0;
+      int bitCount = 0;
+      for (char c : str) {
+        if (c == '=') {
+          break;
+        }
+        const char* p = c ? std::strchr(base64Chars, c) : nullptr;
+        if (!p) {
+          throw std::runtime_error("Invalid base64 character");
+        }
+        bits = bits << 6 | (p - base64Chars);
+        bitCount += 6;
+        if (bitCount >= 8) {
+          bitCount -= 8;
+          data.push_back(bits >> bitCount & 255);
+        }
+      }
+      return data;
+    }
+  }
+
+  namespace system {
+    bool createDirectories(const std::string& path) {
+      std::error_code error;
+      return std::filesystem::create_directories(path, error) || !error;
+    }
+
+    bool rename(const std::string& srcPath, const std::string& destPath) {
+      std::error_code error;
+      std::filesystem::rename(srcPath, destPath, error);
+      return !error;
+    }
+
+    std::string getDirectory(const std::string& path) {
+      return std::filesystem::path(path).parent_path().string();
+    }
+
+    double getUnixTime() {
+      return (double)std::time(nullptr) + testing::unixTimeOffset;
+    }
+  }
+
+  namespace asset {
+    // RACK_USER_DIR stands in for Rack's user folder, so tests can start from an empty one
+    std::string user(const std::string& filename) {
+      const char* dir = std::getenv("RACK_USER_DIR");
+      return std::string(dir ? dir : ".") + "/" + filename;
+    }
+
+    std::string plugin(plugin::Plugin* plugin, const std::string& filename) {
+      return filename;
+    }
+  }
+
+  namespace engine {
+    Module::~Module() {
+      for (ParamQuantity* q : paramQuantities) {
+        delete q;
+      }
+    }
+
+    void Module::config(int numParams, int numInputs, int numOutputs, int numLights) {
+      params.resize(numParams);
+      inputs.resize(numInputs);
+      outputs.resize(numOutputs);
+      lights.resize(numLights);
+      paramQuantities.resize(numParams, nullptr);
+    }
+
+    std::string ParamQuantity::getDisplayValueString() {
+      return string::f("%.3g", getDisplayValue());
+    }
+  }
+
+  namespace testing {
+    double unixTimeOffset = 0;
+  }
+}
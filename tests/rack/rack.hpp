@@ -0,0 +1,483 @@
+#pragma once
+
+// A headless stand-in for the parts of the Rack 2 SDK the engine side of the modules uses, so the
+// tests and bench build and run without the SDK or a window. Behaviour follows Rack's own where
+// the modules depend on it (SIMD masks, Schmitt triggers, pulse generators, polyphonic ports), and
+// everything here is declared in the same namespaces, so sources compile unchanged.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <emmintrin.h>
+#include <smmintrin.h>
+#include <xmmintrin.h>
+
+// Jansson, as far as module state goes - defined in rack.cpp
+struct json_t;
+json_t* json_object();
+json_t* json_array();
+json_t* json_real(double value);
+json_t* json_integer(long long value);
+json_t* json_string(const char* value);
+json_t* json_boolean(int value);
+json_t* json_true();
+json_t* json_false();
+json_t* json_incref(json_t* json);
+void json_decref(json_t* json);
+int json_object_set_new(json_t* object, const char* key, json_t* value);
+int json_object_set(json_t* object, const char* key, json_t* value);
+int json_object_update(json_t* object, json_t* other);
+json_t* json_object_get(const json_t* object, const char* key);
+int json_array_append_new(json_t* array, json_t* value);
+int json_array_append(json_t* array, json_t* value);
+size_t json_array_size(const json_t* array);
+json_t* json_array_get(const json_t* array, size_t index);
+bool json_is_array(const json_t* json);
+bool json_is_object(const json_t* json);
+bool json_is_number(const json_t* json);
+bool json_is_integer(const json_t* json);
+bool json_is_string(const json_t* json);
+bool json_is_boolean(const json_t* json);
+bool json_is_true(const json_t* json);
+double json_number_value(const json_t* json);
+long long json_integer_value(const json_t* json);
+const char* json_string_value(const json_t* json);
+
+#define json_array_foreach(array, index, value) \
+  for (index = 0; index < json_array_size(array) && (value = json_array_get(array, index)); index++)
+
+#define DEBUG(...) ((void)0)
+#define INFO(...) ((void)0)
+#define WARN(...) ((void)0)
+
+namespace rack {
+  namespace string {
+    std::string f(const char* format, ...);
+    std::string toBase64(const uint8_t* data, size_t dataLen);
+    std::string toBase64(const std::vector<uint8_t>& data);
+    std::vector<uint8_t> fromBase64(const std::string& str);
+  }
+
+  namespace system {
+    bool createDirectories(const std::string& path);
+    bool rename(const std::string& srcPath, const std::string& destPath);
+    std::string getDirectory(const std::string& path);
+    double getUnixTime();
+  }
+
+  namespace math {
+    inline int clamp(int x, int a, int b) {
+      return std::max(std::min(x, b), a);
+    }
+
+    inline float clamp(float x, float a = 0.f, float b = 1.f) {
+      return std::fmax(std::fmin(x, b), a);
+    }
+  }
+
+  namespace simd {
+    template <typename T, int N>
+    struct Vector;
+
+    template <>
+    struct Vector<int32_t, 4>;
+
+    template <>
+    struct Vector<float, 4> {
+      __m128 v;
+
+      Vector() = default;
+      Vector(__m128 v) : v(v) {}
+      Vector(float x) : v(_mm_set1_ps(x)) {}
+      Vector(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) {}
+      inline Vector(Vector<int32_t, 4> a);
+
+      static Vector zero() { return Vector(0.f); }
+      static Vector mask() { return Vector(_mm_castsi128_ps(_mm_set1_epi32(-1))); }
+      static Vector load(const float* x) { return Vector(_mm_loadu_ps(x)); }
+      void store(float* x) { _mm_storeu_ps(x, v); }
+      float& operator[](int i) { return ((float*)&v)[i]; }
+      const float& operator[](int i) const { return ((const float*)&v)[i]; }
+    };
+
+    template <>
+    struct Vector<int32_t, 4> {
+      __m128i v;
+
+      Vector() = default;
+      Vector(__m128i v) : v(v) {}
+      Vector(int32_t x) : v(_mm_set1_epi32(x)) {}
+      Vector(Vector<float, 4> a) : v(_mm_cvttps_epi32(a.v)) {}
+
+      static Vector load(const int32_t* x) { return Vector(_mm_loadu_si128((const __m128i*)x)); }
+      void store(int32_t* x) { _mm_storeu_si128((__m128i*)x, v); }
+      int32_t& operator[](int i) { return ((int32_t*)&v)[i]; }
+      const int32_t& operator[](int i) const { return ((const int32_t*)&v)[i]; }
+    };
+
+    inline Vector<float, 4>::Vector(Vector<int32_t, 4> a) : v(_mm_cvtepi32_ps(a.v)) {}
+
+    typedef Vector<float, 4> float_4;
+    typedef Vector<int32_t, 4> int32_4;
+
+    #define SIMD_OPERATOR(op, fn) \
+      inline float_4 operator op(float_4 a, float_4 b) { return float_4(fn(a.v, b.v)); } \
+      inline float_4 operator op(float a, float_4 b) { return float_4(a) op b; } \
+      inline float_4 operator op(float_4 a, float b) { return a op float_4(b); }
+    SIMD_OPERATOR(+, _mm_add_ps)
+    SIMD_OPERATOR(-, _mm_sub_ps)
+    SIMD_OPERATOR(*, _mm_mul_ps)
+    SIMD_OPERATOR(/, _mm_div_ps)
+    SIMD_OPERATOR(==, _mm_cmpeq_ps)
+    SIMD_OPERATOR(!=, _mm_cmpneq_ps)
+    SIMD_OPERATOR(>=, _mm_cmpge_ps)
+    SIMD_OPERATOR(>, _mm_cmpgt_ps)
+    SIMD_OPERATOR(<=, _mm_cmple_ps)
+    SIMD_OPERATOR(<, _mm_cmplt_ps)
+    SIMD_OPERATOR(&, _mm_and_ps)
+    SIMD_OPERATOR(|, _mm_or_ps)
+    SIMD_OPERATOR(^, _mm_xor_ps)
+    #undef SIMD_OPERATOR
+
+    inline float_4 operator-(float_4 a) { return 0.f - a; }
+    inline float_4 operator~(float_4 a) { return a ^ float_4::mask(); }
+    inline float_4& operator+=(float_4& a, float_4 b) { return a = a + b; }
+    inline float_4& operator-=(float_4& a, float_4 b) { return a = a - b; }
+    inline float_4& operator*=(float_4& a, float_4 b) { return a = a * b; }
+    inline float_4& operator&=(float_4& a, float_4 b) { return a = a & b; }
+    inline float_4& operator|=(float_4& a, float_4 b) { return a = a | b; }
+
+    inline int32_4 operator+(int32_4 a, int32_4 b) { return int32_4(_mm_add_epi32(a.v, b.v)); }
+    inline int32_4 operator-(int32_4 a, int32_4 b) { return int32_4(_mm_sub_epi32(a.v, b.v)); }
+    inline int32_4 operator*(int32_4 a, int32_4 b) { return int32_4(_mm_mullo_epi32(a.v, b.v)); }
+    inline int32_4 operator&(int32_4 a, int32_4 b) { return int32_4(_mm_and_si128(a.v, b.v)); }
+    inline int32_4 operator|(int32_4 a, int32_4 b) { return int32_4(_mm_or_si128(a.v, b.v)); }
+    inline int32_4 operator^(int32_4 a, int32_4 b) { return int32_4(_mm_xor_si128(a.v, b.v)); }
+    inline int32_4 operator<<(int32_4 a, int b) { return int32_4(_mm_slli_epi32(a.v, b)); }
+    inline int32_4 operator>>(int32_4 a, int b) { return int32_4(_mm_srai_epi32(a.v, b)); }
+
+    inline float_4 ifelse(float_4 mask, float_4 a, float_4 b) {
+      return (a & mask) | float_4(_mm_andnot_ps(mask.v, b.v));
+    }
+
+    inline int movemask(float_4 a) { return _mm_movemask_ps(a.v); }
+
+    template <typename T>
+    T movemaskInverse(int a);
+
+    template <>
+    inline float_4 movemaskInverse<float_4>(int a) {
+      __m128i bits = _mm_set_epi32(8, 4, 2, 1);
+      __m128i x = _mm_and_si128(_mm_set1_epi32(a), bits);
+      return float_4(_mm_castsi128_ps(_mm_cmpeq_epi32(x, bits)));
+    }
+
+    inline float_4 fmax(float_4 a, float_4 b) { return float_4(_mm_max_ps(a.v, b.v)); }
+    inline float_4 fmin(float_4 a, float_4 b) { return float_4(_mm_min_ps(a.v, b.v)); }
+    inline float_4 clamp(float_4 x, float_4 a = 0.f, float_4 b = 1.f) { return fmin(fmax(x, a), b); }
+    inline float_4 floor(float_4 a) { return float_4(_mm_floor_ps(a.v)); }
+    inline float_4 ceil(float_4 a) { return float_4(_mm_ceil_ps(a.v)); }
+  }
+
+  namespace dsp {
+    // The SIMD versions return masks, as Rack's do
+    template <typename T = float>
+    struct TSchmittTrigger {
+      T state = T::mask();
+
+      void reset() { state = T::mask(); }
+
+      T process(T in, T offThreshold = 0.f, T onThreshold = 1.f) {
+        T on = in >= onThreshold;
+        T off = in <= offThreshold;
+        T triggered = ~state & on;
+        state = on | (state & ~off);
+        return triggered;
+      }
+
+      T isHigh() { return state; }
+    };
+
+    template <>
+    struct TSchmittTrigger<float> {
+      bool state = true;
+
+      void reset() { state = true; }
+
+      bool process(float in, float offThreshold = 0.f, float onThreshold = 1.f) {
+        if (state) {
+          if (in <= offThreshold) {
+            state = false;
+          }
+        } else if (in >= onThreshold) {
+          state = true;
+          return true;
+        }
+        return false;
+      }
+
+      bool isHigh() { return state; }
+    };
+
+    typedef TSchmittTrigger<> SchmittTrigger;
+
+    // The SIMD version returns 1 or 0 per lane, not a mask, as Rack's does
+    template <typename T = float>
+    struct TPulseGenerator {
+      T remaining = 0.f;
+
+      void reset() { remaining = 0.f; }
+
+      T process(float deltaTime) {
+        T mask = remaining > 0.f;
+        remaining -= deltaTime;
+        return simd::ifelse(mask, 1.f, 0.f);
+      }
+
+      void trigger(T duration = 1e-3f) { remaining = simd::fmax(duration, remaining); }
+    };
+
+    template <>
+    struct TPulseGenerator<float> {
+      float remaining = 0.f;
+
+      void reset() { remaining = 0.f; }
+
+      bool process(float deltaTime) {
+        bool isHigh = remaining > 0.f;
+        remaining -= deltaTime;
+        return isHigh;
+      }
+
+      void trigger(float duration = 1e-3f) { remaining = std::max(duration, remaining); }
+    };
+
+    typedef TPulseGenerator<> PulseGenerator;
+
+    struct ClockDivider {
+      uint32_t clock = 0;
+      uint32_t division = 1;
+
+      void reset() { clock = 0; }
+      void setDivision(uint32_t division) { this->division = division; }
+      uint32_t getDivision() { return division; }
+      uint32_t getClock() { return clock; }
+
+      bool process() {
+        if (++clock >= division) {
+          clock = 0;
+          return true;
+        }
+        return false;
+      }
+    };
+  }
+
+  namespace engine {
+    struct Param {
+      float value = 0.f;
+
+      float getValue() { return value; }
+      void setValue(float value) { this->value = value; }
+    };
+
+    struct Port {
+      float voltages[16] = {};
+      uint8_t channels = 0;
+
+      float getVoltage(int c = 0) { return voltages[c]; }
+      void setVoltage(float voltage, int c = 0) { voltages[c] = voltage; }
+      float getPolyVoltage(int c) { return isMonophonic() ? getVoltage(0) : getVoltage(c); }
+
+      template <typename T>
+      T getVoltageSimd(int c) { return T::load(&voltages[c]); }
+
+      template <typename T>
+      T getPolyVoltageSimd(int c) { return isMonophonic() ? T(getVoltage(0)) : getVoltageSimd<T>(c); }
+
+      template <typename T>
+      void setVoltageSimd(T voltage, int c) { voltage.store(&voltages[c]); }
+
+      int getChannels() { return channels; }
+      // As in Rack, unconnected ports stay at 0 channels, and connected ones at 1 or more
+      void setChannels(int channels) {
+        if (this->channels == 0) {
+          return;
+        }
+        for (int c = channels; c < this->channels; c++) {
+          voltages[c] = 0.f;
+        }
+        this->channels = std::max(channels, 1);
+      }
+
+      // Not in Rack, where the engine does this as cables are added and removed
+      void connect(int channels = 1) { this->channels = std::max(channels, 1); }
+      void disconnect() {
+        channels = 0;
+        std::fill(std::begin(voltages), std::end(voltages), 0.f);
+      }
+      bool isConnected() { return channels > 0; }
+      bool isMonophonic() { return channels == 1; }
+      bool isPolyphonic() { return channels > 1; }
+    };
+
+    struct Input : Port {};
+    struct Output : Port {};
+
+    struct Light {
+      float value = 0.f;
+
+      void setBrightness(float brightness) { value = brightness; }
+      float getBrightness() { return value; }
+
+      // Rack's lambda is 30 / s
+      void setSmoothBrightness(float brightness, float deltaTime) {
+        value += (brightness - value) * std::min(1.f, deltaTime * 30.f);
+      }
+    };
+
+    struct ParamQuantity;
+
+    struct Module {
+      struct ProcessArgs {
+        float sampleRate;
+        float sampleTime;
+        int64_t frame;
+      };
+      struct AddEvent {};
+      struct RemoveEvent {};
+      struct ResetEvent {};
+      struct RandomizeEvent {};
+      struct SampleRateChangeEvent {
+        float sampleRate;
+        float sampleTime;
+      };
+
+      int64_t id = -1;
+      std::vector<Param> params;
+      std::vector<Input> inputs;
+      std::vector<Output> outputs;
+      std::vector<Light> lights;
+      std::vector<ParamQuantity*> paramQuantities;
+
+      virtual ~Module();
+
+      void config(int numParams, int numInputs, int numOutputs, int numLights);
+
+      template <class TParamQuantity = ParamQuantity>
+      TParamQuantity* configParam(int paramId, float minValue, float maxValue, float defaultValue,
+          std::string name = "", std::string unit = "", float displayBase = 0.f,
+          float displayMultiplier = 1.f, float displayOffset = 0.f);
+
+      template <class TSwitchQuantity = ParamQuantity>
+      TSwitchQuantity* configSwitch(int paramId, float minValue, float maxValue, float defaultValue,
+          std::string name = "", std::vector<std::string> labels = {});
+
+      template <class TSwitchQuantity = ParamQuantity>
+      TSwitchQuantity* configButton(int paramId, std::string name = "");
+
+      void configInput(int portId, std::string name = "") {}
+      void configOutput(int portId, std::string name = "") {}
+
+      ParamQuantity* getParamQuantity(int paramId) { return paramQuantities[paramId]; }
+
+      virtual void process(const ProcessArgs& args) {}
+      virtual json_t* dataToJson() { return nullptr; }
+      virtual void dataFromJson(json_t* rootJ) {}
+      virtual void onAdd(const AddEvent& e) {}
+      virtual void onRemove(const RemoveEvent& e) {}
+      virtual void onReset(const ResetEvent& e) { onReset(); }
+      virtual void onRandomize(const RandomizeEvent& e) { onRandomize(); }
+      virtual void onReset() {}
+      virtual void onRandomize() {}
+      virtual void onSampleRateChange(const SampleRateChangeEvent& e) {}
+    };
+
+    struct ParamQuantity {
+      Module* module = nullptr;
+      int paramId = 0;
+      float minValue = 0.f;
+      float maxValue = 1.f;
+      float defaultValue = 0.f;
+      std::string name;
+      bool randomizeEnabled = true;
+      bool snapEnabled = false;
+
+      virtual ~ParamQuantity() {}
+
+      virtual void setValue(float value) { module->params[paramId].setValue(value); }
+      virtual float getValue() { return module->params[paramId].getValue(); }
+      virtual float getDisplayValue() { return getValue(); }
+      virtual void setDisplayValue(float displayValue) { setValue(displayValue); }
+      virtual std::string getDisplayValueString();
+      virtual void setDisplayValueString(std::string s) {}
+      virtual std::string getLabel() { return name; }
+      virtual std::string getString() { return getLabel() + ": " + getDisplayValueString(); }
+      virtual std::string getDescription() { return ""; }
+
+      float getMinValue() { return minValue; }
+      float getMaxValue() { return maxValue; }
+      float getDefaultValue() { return defaultValue; }
+    };
+
+    template <class TParamQuantity>
+    TParamQuantity* Module::configParam(int paramId, float minValue, float maxValue,
+        float defaultValue, std::string name, std::string unit, float displayBase,
+        float displayMultiplier, float displayOffset) {
+      delete paramQuantities[paramId];
+
+      TParamQuantity* q = new TParamQuantity;
+      q->module = this;
+      q->paramId = paramId;
+      q->minValue = minValue;
+      q->maxValue = maxValue;
+      q->defaultValue = defaultValue;
+      q->name = name;
+      paramQuantities[paramId] = q;
+      params[paramId].value = defaultValue;
+      return q;
+    }
+
+    template <class TSwitchQuantity>
+    TSwitchQuantity* Module::configSwitch(int paramId, float minValue, float maxValue,
+        float defaultValue, std::string name, std::vector<std::string> labels) {
+      TSwitchQuantity* q = configParam<TSwitchQuantity>(paramId, minValue, maxValue, defaultValue, name);
+      q->snapEnabled = true;
+      return q;
+    }
+
+    template <class TSwitchQuantity>
+    TSwitchQuantity* Module::configButton(int paramId, std::string name) {
+      TSwitchQuantity* q = configParam<TSwitchQuantity>(paramId, 0.f, 1.f, 0.f, name);
+      q->randomizeEnabled = false;
+      return q;
+    }
+  }
+
+  namespace plugin {
+    struct Model;
+    struct Plugin {
+      std::string slug;
+    };
+  }
+
+  namespace asset {
+    std::string user(const std::string& filename);
+    std::string plugin(plugin::Plugin* plugin, const std::string& filename);
+  }
+
+  using namespace math;
+  using namespace engine;
+  using plugin::Plugin;
+  using plugin::Model;
+}
+
+// Not part of Rack - lets tests age what getUnixTime reports
+namespace rack {
+  namespace testing {
+    extern double unixTimeOffset;
+  }
+}
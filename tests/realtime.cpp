@@ -0,0 +1,154 @@
+// Drives EntropyBase::process through every combination of inputs and settings it treats
+// differently, failing if the audio thread allocates, frees, locks, or makes a system call - the
+// UI thread's side runs between blocks, unwatched, as it would in Rack
+
+#include "hooks.hpp"
+#include "../src/modules/EntropyBase/EntropyBase.hpp"
+
+#include <cstdio>
+#include <string>
+
+using namespace rack;
+
+namespace {
+  struct Range {
+    const char* name;
+    float start;
+    float length;
+  };
+
+  const Range ranges[] = {
+    {"full", 0.f, 1.f},
+    {"short", .25f, .1f},
+    {"single step", .5f, 0.f},
+    {"reversed", .5f, -.4f},
+    {"wrapping", .9f, .3f},
+    {"reversed wrapping", .1f, -.3f}
+  };
+
+  struct Scenario {
+    int channels;
+    bool isCvConnected;
+    const Range* range;
+    EntropyBase::Engine engine;
+    bool isEndless;
+    bool isSkipFiltered;
+    int controlRate;
+
+    std::string describe() const {
+      return string::f(
+        "%d channel%s, %s CV, %s range, %s engine%s%s, control rate %d",
+        channels,
+        channels == 1 ? "" : "s",
+        isCvConnected ? "with" : "without",
+        range->name,
+        engine == EntropyBase::COUNTER_ENGINE ? "counter" : "Mersenne Twister",
+        isEndless ? ", endless" : "",
+        isSkipFiltered ? ", skipping" : "",
+        controlRate
+      );
+    }
+  };
+
+  const int BLOCK_SIZE = 64;
+  const int NUM_BLOCKS = 48;
+
+  template <int LENGTH>
+  std::string run(const Scenario& scenario) {
+    EntropyModule<LENGTH> module;
+    Module& m = module;
+    m.onAdd(Module::AddEvent());
+
+    module.setEngine(scenario.engine);
+    module.setEndless(scenario.isEndless);
+    module.setSkipFiltered(scenario.isSkipFiltered);
+    module.setControlRate(scenario.controlRate);
+
+    m.params[EntropyBase::RUN_PARAM].setValue(1.f);
+    m.params[EntropyBase::START_PARAM].setValue(scenario.range->start);
+    m.params[EntropyBase::LENGTH_PARAM].setValue(scenario.range->length);
+    m.params[EntropyBase::FILTER_PARAM].setValue(.2f);
+    for (int id : {EntropyBase::START_CV_PARAM, EntropyBase::LENGTH_CV_PARAM, EntropyBase::FILTER_CV_PARAM}) {
+      m.params[id].setValue(scenario.isCvConnected ? .5f : 0.f);
+    }
+
+    m.inputs[EntropyBase::CLOCK_INPUT].connect(scenario.channels);
+    m.inputs[EntropyBase::RESET_INPUT].connect(scenario.channels);
+    m.inputs[EntropyBase::RANDOM_INPUT].connect();
+    if (scenario.isCvConnected) {
+      for (int id : {EntropyBase::START_INPUT, EntropyBase::LENGTH_INPUT, EntropyBase::FILTER_INPUT}) {
+        m.inputs[id].connect(scenario.channels);
+      }
+    }
+    // Every output, so nothing process only does for connected outputs is missed
+    for (Output& output : m.outputs) {
+      output.connect();
+    }
+
+    Module::ProcessArgs args = {48000.f, 1.f / 48000.f, 0};
+    for (int block = 0; block < NUM_BLOCKS; block++) {
+      // The UI thread's share - refills, completions, and the odd edit
+      module.prepareRandomValues();
+      JobPool::get().runCompletions();
+      if (block % 8 == 3 && !scenario.isEndless) {
+        module.values.set(block % LENGTH, (block % 5) / 4.f);
+      }
+
+      hooks::watch(true);
+      for (int i = 0; i < BLOCK_SIZE; i++, args.frame++) {
+        int frame = (int)args.frame;
+        for (int c = 0; c < scenario.channels; c++) {
+          // Clocks at different rates per channel, and resets now and then
+          m.inputs[EntropyBase::CLOCK_INPUT].setVoltage((frame / (2 + c)) % 2 ? 10.f : 0.f, c);
+          m.inputs[EntropyBase::RESET_INPUT].setVoltage(frame % 701 == 37 * c ? 10.f : 0.f, c);
+          // Slow sweeps across the whole CV range
+          m.inputs[EntropyBase::START_INPUT].setVoltage((frame + 97 * c) % 1000 / 100.f - 5.f, c);
+          m.inputs[EntropyBase::LENGTH_INPUT].setVoltage((frame * 3 + 31 * c) % 1000 / 100.f - 5.f, c);
+          m.inputs[EntropyBase::FILTER_INPUT].setVoltage((frame * 7 + 13 * c) % 1000 / 100.f - 5.f, c);
+        }
+        m.inputs[EntropyBase::RANDOM_INPUT].setVoltage(frame % 400 < 20 ? 10.f : 0.f);
+        m.params[EntropyBase::CLOCK_PARAM].setValue(frame % 300 < 2 ? 1.f : 0.f);
+        m.params[EntropyBase::RESET_PARAM].setValue(frame % 1100 < 2 ? 1.f : 0.f);
+        m.params[EntropyBase::RANDOM_PARAM].setValue(frame % 900 < 2 ? 1.f : 0.f);
+
+        m.process(args);
+      }
+      hooks::watch(false);
+    }
+
+    return hooks::takeAll();
+  }
+}
+
+int main() {
+  if (!hooks::check()) {
+    return 1;
+  }
+
+  int failures = 0;
+  int scenarios = 0;
+  for (int channels : {1, 4, 5, 16})
+  for (bool isCvConnected : {false, true})
+  for (const Range& range : ranges)
+  for (EntropyBase::Engine engine : {EntropyBase::MERSENNE_TWISTER_ENGINE, EntropyBase::COUNTER_ENGINE})
+  for (bool isEndless : {false, true})
+  for (bool isSkipFiltered : {false, true})
+  for (int controlRate : {EntropyBase::CONTROL_RATES.front(), EntropyBase::CONTROL_RATES.back()}) {
+    Scenario scenario = {channels, isCvConnected, &range, engine, isEndless, isSkipFiltered, controlRate};
+    // Both module sizes, as the length changes which tables are rebuilt and when
+    for (std::string hits : {run<240>(scenario), run<96>(scenario)}) {
+      scenarios++;
+      if (!hits.empty()) {
+        std::printf("FAIL: %s: %s\n", scenario.describe().c_str(), hits.c_str());
+        failures++;
+      }
+    }
+  }
+
+  if (failures) {
+    std::printf("%d of %d scenarios touched the allocator, a lock, or a system call in process\n", failures, scenarios);
+    return 1;
+  }
+  std::printf("ok: %d scenarios, no allocations, locks or system calls in process\n", scenarios);
+  return 0;
+}